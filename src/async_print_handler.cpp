@@ -0,0 +1,151 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#if UUID_LOG_THREAD_SAFE
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace uuid {
+
+namespace log {
+
+AsyncPrintHandler::AsyncPrintHandler(::Print &print)
+		: PrintHandler(print), writer_(&AsyncPrintHandler::run, this) {
+}
+
+AsyncPrintHandler::AsyncPrintHandler(::Print &print, bool lock_free)
+		: PrintHandler(print, lock_free), writer_(&AsyncPrintHandler::run, this) {
+}
+
+AsyncPrintHandler::~AsyncPrintHandler() {
+	/* Messages must not be added while the writer thread is stopping */
+	Logger::unregister_handler(this);
+
+	{
+		std::lock_guard<std::mutex> lock{writer_mutex_};
+		stop_ = true;
+	}
+
+	writer_cv_.notify_one();
+	writer_.join();
+}
+
+size_t AsyncPrintHandler::flush_messages() const {
+	return flush_messages_;
+}
+
+void AsyncPrintHandler::flush_messages(size_t count) {
+	flush_messages_ = count;
+	notify();
+}
+
+size_t AsyncPrintHandler::flush_bytes() const {
+	return flush_bytes_;
+}
+
+void AsyncPrintHandler::flush_bytes(size_t size) {
+	flush_bytes_ = size;
+	notify();
+}
+
+uint32_t AsyncPrintHandler::flush_interval_ms() const {
+	return flush_interval_ms_;
+}
+
+void AsyncPrintHandler::flush_interval_ms(uint32_t interval_ms) {
+	flush_interval_ms_ = interval_ms;
+	notify();
+}
+
+void AsyncPrintHandler::operator<<(std::shared_ptr<Message> message) {
+	const size_t length = message->text.formatted() ? message->text.length() : 0;
+
+	PrintHandler::operator<<(std::move(message));
+
+	const size_t messages = pending_messages_.fetch_add(1) + 1;
+	const size_t bytes = pending_bytes_.fetch_add(length) + length;
+	const size_t flush_bytes = flush_bytes_;
+
+	/*
+	 * Only wake up the writer thread to start waiting for the flush
+	 * interval or when a limit is reached, so that most messages are
+	 * added without any system calls.
+	 */
+	if (messages == 1 || messages == flush_messages_
+			|| (bytes >= flush_bytes && bytes - length < flush_bytes)) {
+		notify();
+	}
+}
+
+bool AsyncPrintHandler::flush_required() const {
+	return pending_messages_ >= flush_messages_ || pending_bytes_ >= flush_bytes_;
+}
+
+void AsyncPrintHandler::notify() {
+	{
+		/* Lock the mutex so that the writer thread can't miss the change */
+		std::lock_guard<std::mutex> lock{writer_mutex_};
+	}
+
+	writer_cv_.notify_one();
+}
+
+void AsyncPrintHandler::run() {
+	std::unique_lock<std::mutex> lock{writer_mutex_};
+
+	while (true) {
+		writer_cv_.wait(lock, [this] { return stop_ || pending_messages_ > 0; });
+
+		if (!stop_) {
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(flush_interval_ms_);
+
+			writer_cv_.wait_until(lock, deadline, [this] { return stop_ || flush_required(); });
+		}
+
+		/* Always write queued messages before stopping */
+		const bool stop = stop_;
+
+		pending_messages_ = 0;
+		pending_bytes_ = 0;
+
+		lock.unlock();
+		loop();
+
+		if (stop) {
+			break;
+		}
+
+		lock.lock();
+	}
+}
+
+} // namespace log
+
+} // namespace uuid
+
+#endif
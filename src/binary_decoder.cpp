@@ -0,0 +1,198 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#include <Arduino.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace uuid {
+
+namespace log {
+
+//! @cond false
+static constexpr unsigned int BINARY_LEVELS = Level::TRACE - Level::EMERG + 1;
+
+enum VarintResult : int8_t {
+	VARINT_INVALID = -1,
+	VARINT_INCOMPLETE = 0,
+	VARINT_OK = 1,
+};
+
+static VarintResult read_varint(const std::string &data, size_t &pos, uint64_t &value) {
+	value = 0;
+
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		if (pos >= data.size()) {
+			return VARINT_INCOMPLETE;
+		}
+
+		uint8_t c = data[pos++];
+
+		value |= static_cast<uint64_t>(c & 0x7F) << shift;
+		if (!(c & 0x80)) {
+			return VARINT_OK;
+		}
+	}
+
+	return VARINT_INVALID;
+}
+//! @endcond
+
+BinaryDecoder::BinaryDecoder(Handler &handler) : handler_(handler) {
+}
+
+unsigned long BinaryDecoder::dropped_messages() const {
+	return dropped_messages_;
+}
+
+void BinaryDecoder::reset() {
+	pending_.clear();
+	uptime_ms_ = 0;
+	ids_.clear();
+	names_.clear();
+}
+
+bool BinaryDecoder::decode(const uint8_t *data, size_t length) {
+	size_t pos = 0;
+	bool valid = true;
+
+	pending_.append(reinterpret_cast<const char *>(data), length);
+
+	while (decode_record(pos, valid));
+
+	if (!valid) {
+		pending_.clear();
+		return false;
+	}
+
+	pending_.erase(0, pos);
+	return true;
+}
+
+bool BinaryDecoder::decode_record(size_t &pos, bool &valid) {
+	size_t next = pos;
+	uint64_t values[3];
+	VarintResult result;
+
+	if (next >= pending_.size()) {
+		return false;
+	}
+
+	const uint8_t type = pending_[next++];
+	const size_t count = type == BinaryHandler::NAME_RECORD ? 2 : 3;
+
+	if (type != BinaryHandler::NAME_RECORD && type >= (Facility::LOCAL7 + 1) * BINARY_LEVELS) {
+		valid = false;
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		result = read_varint(pending_, next, values[i]);
+
+		if (result != VARINT_OK) {
+			valid = result != VARINT_INVALID;
+			return false;
+		}
+	}
+
+	const uint64_t id = values[count - 2];
+	const uint64_t length = values[count - 1];
+
+	const size_t max_length = type == BinaryHandler::NAME_RECORD
+		? size_t{BinaryHandler::MAX_NAME_LENGTH} : size_t{Logger::MAX_LOG_LENGTH};
+
+	if (length > max_length) {
+		valid = false;
+		return false;
+	}
+
+	if (pending_.size() - next < length) {
+		return false;
+	}
+
+	const char *text = &pending_[next];
+
+	if (type == BinaryHandler::NAME_RECORD) {
+		if (id == 0) {
+			/* Start of a new stream */
+			uptime_ms_ = 0;
+			ids_.clear();
+		}
+
+		if (id != ids_.size()) {
+			valid = false;
+			return false;
+		}
+
+		/* Names of messages that may still be in use must not be freed */
+		const char *name = nullptr;
+
+		for (auto &existing : names_) {
+			if (::strlen(existing.get()) == length && !::memcmp(existing.get(), text, length)) {
+				name = existing.get();
+				break;
+			}
+		}
+
+		if (!name) {
+			std::unique_ptr<char[]> copy{new char[length + 1]};
+
+			::memcpy(copy.get(), text, length);
+			copy[length] = '\0';
+			name = copy.get();
+			names_.push_back(std::move(copy));
+		}
+
+		ids_.push_back(name);
+	} else {
+		if (id >= ids_.size()) {
+			valid = false;
+			return false;
+		}
+
+		const uint64_t delta = values[0];
+
+		uptime_ms_ += static_cast<uint64_t>(static_cast<int64_t>(delta >> 1) ^ -static_cast<int64_t>(delta & 1));
+
+		auto message = Message::create(uptime_ms_,
+			static_cast<Level>(type % BINARY_LEVELS),
+			static_cast<Facility>(type / BINARY_LEVELS),
+			reinterpret_cast<const __FlashStringHelper *>(ids_[id]),
+			text, length);
+
+		if (message) {
+			handler_ << std::move(message);
+		} else {
+			dropped_messages_++;
+		}
+	}
+
+	pos = next + length;
+	return true;
+}
+
+} // namespace log
+
+} // namespace uuid
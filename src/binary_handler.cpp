@@ -0,0 +1,175 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#if UUID_LOG_THREAD_SAFE
+# include <mutex>
+#endif
+#include <string>
+#include <vector>
+
+namespace uuid {
+
+namespace log {
+
+//! @cond false
+/*
+ * The first byte of a message record is the facility and level
+ * combined (facility * 9 + level), which is always less than
+ * BinaryHandler::NAME_RECORD.
+ */
+static constexpr unsigned int BINARY_LEVELS = Level::TRACE - Level::EMERG + 1;
+
+static_assert((Facility::LOCAL7 + 1) * BINARY_LEVELS <= BinaryHandler::NAME_RECORD,
+	"Facility and level must fit in the first byte of a record");
+
+static void append_varint(std::string &output, uint64_t value) {
+	while (value >= 0x80) {
+		output.push_back(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	output.push_back(static_cast<char>(value));
+}
+//! @endcond
+
+BinaryHandler::BinaryHandler(::Print &print) : print_(print) {
+}
+
+BinaryHandler::~BinaryHandler() {
+	Logger::unregister_handler(this);
+}
+
+size_t BinaryHandler::maximum_buffer_size() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	return maximum_buffer_size_;
+}
+
+void BinaryHandler::maximum_buffer_size(size_t size) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	maximum_buffer_size_ = size;
+}
+
+unsigned long BinaryHandler::dropped_messages() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	return dropped_messages_;
+}
+
+void BinaryHandler::reset() {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	buffer_.clear();
+	names_.clear();
+	last_uptime_ms_ = 0;
+}
+
+void BinaryHandler::loop() {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> output_lock{output_mutex_};
+#endif
+
+	output_.clear();
+
+	{
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+		/* Swap buffers so that both keep their capacity */
+		buffer_.swap(output_);
+	}
+
+	if (!output_.empty()) {
+		print_.write(reinterpret_cast<const uint8_t *>(output_.data()), output_.size());
+	}
+}
+
+void BinaryHandler::operator<<(std::shared_ptr<Message> message) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	const size_t start = buffer_.size();
+	const size_t names = names_.size();
+	const size_t id = name_id(message->name);
+	const int64_t delta = static_cast<int64_t>(message->uptime_ms - last_uptime_ms_);
+	size_t length = message->text.length();
+
+	if (length > Logger::MAX_LOG_LENGTH) {
+		length = Logger::MAX_LOG_LENGTH;
+	}
+
+	buffer_.push_back(static_cast<char>(message->facility * BINARY_LEVELS
+		+ std::max(Level::EMERG, std::min(message->level, Level::TRACE))));
+	/* Messages from other threads can be received out of order */
+	append_varint(buffer_, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+	append_varint(buffer_, id);
+	append_varint(buffer_, length);
+	buffer_.append(message->text.c_str(), length);
+
+	if (buffer_.size() > maximum_buffer_size_) {
+		buffer_.resize(start);
+		names_.resize(names);
+		dropped_messages_++;
+		return;
+	}
+
+	last_uptime_ms_ = message->uptime_ms;
+}
+
+/* Mutex already locked by caller. */
+size_t BinaryHandler::name_id(const __FlashStringHelper *name) {
+	auto it = std::find(names_.begin(), names_.end(), name);
+
+	if (it != names_.end()) {
+		return it - names_.begin();
+	}
+
+	const size_t id = names_.size();
+	size_t length = ::strlen_P(reinterpret_cast<PGM_P>(name));
+
+	if (length > MAX_NAME_LENGTH) {
+		length = MAX_NAME_LENGTH;
+	}
+
+	buffer_.push_back(static_cast<char>(NAME_RECORD));
+	append_varint(buffer_, id);
+	append_varint(buffer_, length);
+
+	const size_t pos = buffer_.size();
+
+	buffer_.resize(pos + length);
+	::memcpy_P(&buffer_[pos], reinterpret_cast<PGM_P>(name), length);
+
+	names_.push_back(name);
+	return id;
+}
+
+} // namespace log
+
+} // namespace uuid
@@ -0,0 +1,140 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+
+namespace uuid {
+
+namespace log {
+
+std::atomic<CallSite*> CallSite::first_{nullptr};
+
+//! @cond false
+static bool match_file(const char *site_file, const char *file) {
+	size_t site_len = ::strlen(site_file);
+	size_t len = ::strlen(file);
+
+	if (site_len == len) {
+		return !::strcmp(site_file, file);
+	} else if (site_len > len) {
+		return site_file[site_len - len - 1] == '/'
+			&& !::strcmp(&site_file[site_len - len], file);
+	} else {
+		return false;
+	}
+}
+//! @endcond
+
+size_t CallSite::mode(const char *file, unsigned int line, Mode mode) {
+	size_t count = 0;
+
+	for (CallSite *site = first(); site != nullptr; site = site->next()) {
+		if ((line == 0 || site->line_ == line) && match_file(site->file_, file)) {
+			site->mode_ = mode;
+			count++;
+		}
+	}
+
+	if (count > 0) {
+		Logger::generation_++;
+	}
+
+	return count;
+}
+
+void CallSite::mode(Mode mode) {
+	mode_ = mode;
+	Logger::generation_++;
+}
+
+bool CallSite::refresh(const Logger &logger, Level level) {
+	/*
+	 * Read the generation before the levels so that any concurrent
+	 * change causes another refresh on the next call.
+	 */
+	uint32_t generation = Logger::generation_.load() & GENERATION_MASK;
+	const Logger *expected = nullptr;
+	bool enabled;
+
+	if (!registered_.exchange(true)) {
+		CallSite *first = first_.load(std::memory_order_relaxed);
+
+		do {
+			next_ = first;
+		} while (!first_.compare_exchange_weak(first, this,
+			std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	switch (mode_) {
+	case Mode::ENABLED:
+		enabled = level <= min_level && level <= Logger::global_level(logger.facility());
+		break;
+
+	case Mode::DISABLED:
+		enabled = false;
+		break;
+
+	case Mode::DEFAULT:
+	default:
+		enabled = logger.enabled(level);
+		break;
+	}
+
+	/*
+	 * Only cache the decision for the first logger used with this call
+	 * site, so that the cached state never needs to be replaced with
+	 * one for a different logger.
+	 */
+	if (logger_.compare_exchange_strong(expected, &logger, std::memory_order_relaxed)
+			|| expected == &logger) {
+		state_.store((generation << 1) | (enabled ? 1 : 0), std::memory_order_relaxed);
+	}
+
+	return enabled;
+}
+
+void CallSite::log(const Logger &logger, Level level, const char *format, ...) const {
+	if (!logger.rate_limited(level, logger.facility_)) {
+		va_list ap;
+
+		va_start(ap, format);
+		logger.vlog_internal(level, logger.facility_, format, ap);
+		va_end(ap);
+	}
+}
+
+void CallSite::log(const Logger &logger, Level level, const __FlashStringHelper *format, ...) const {
+	if (!logger.rate_limited(level, logger.facility_)) {
+		va_list ap;
+
+		va_start(ap, format);
+		logger.vlog_internal(level, logger.facility_, format, ap);
+		va_end(ap);
+	}
+}
+
+} // namespace log
+
+} // namespace uuid
@@ -23,7 +23,7 @@ namespace uuid {
 namespace log {
 
 char format_level_char(Level level) {
-	constexpr char log_level_chars[(int)Level::ALL - (int)Level::OFF + 1] = { ' ', 'P', 'A', 'C', 'E', 'W', 'N', 'I', 'D', 'T', ' ' };
+	constexpr char log_level_chars[NUM_LEVELS] = { ' ', 'P', 'A', 'C', 'E', 'W', 'N', 'I', 'D', 'T', ' ' };
 	return log_level_chars[(int)level + 1];
 }
 
@@ -20,6 +20,7 @@
 
 #include <Arduino.h>
 
+#include <array>
 #include <string>
 
 #ifndef PSTR_ALIGN
@@ -33,8 +34,8 @@ namespace log {
 //! @cond false
 static constexpr const char *pstr_level_lowercase_off __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "off";
 static constexpr const char *pstr_level_lowercase_emerg __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "emerg";
-static constexpr const char *pstr_level_lowercase_crit __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "crit";
 static constexpr const char *pstr_level_lowercase_alert __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "alert";
+static constexpr const char *pstr_level_lowercase_crit __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "crit";
 static constexpr const char *pstr_level_lowercase_err __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "err";
 static constexpr const char *pstr_level_lowercase_warning __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "warning";
 static constexpr const char *pstr_level_lowercase_notice __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "notice";
@@ -43,11 +44,11 @@ static constexpr const char *pstr_level_lowercase_debug __attribute__((__aligned
 static constexpr const char *pstr_level_lowercase_trace __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "trace";
 static constexpr const char *pstr_level_lowercase_all __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "all";
 
-static const __FlashStringHelper *log_level_lowercase[(int)Level::ALL - (int)Level::OFF + 1] = {
+static const std::array<const __FlashStringHelper *,NUM_LEVELS> log_level_lowercase = {{
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_off),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_emerg),
-	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_crit),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_alert),
+	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_crit),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_err),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_warning),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_notice),
@@ -55,13 +56,17 @@ static const __FlashStringHelper *log_level_lowercase[(int)Level::ALL - (int)Lev
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_debug),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_trace),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_lowercase_all)
-};
+}};
 //! @endcond
 
 const __FlashStringHelper *format_level_lowercase(Level level) {
 	return log_level_lowercase[(int)level + 1];
 }
 
+const std::array<const __FlashStringHelper *,NUM_LEVELS> &level_names_lowercase() {
+	return log_level_lowercase;
+}
+
 } // namespace log
 
 } // namespace uuid
@@ -20,6 +20,7 @@
 
 #include <Arduino.h>
 
+#include <array>
 #include <string>
 
 #ifndef PSTR_ALIGN
@@ -33,8 +34,8 @@ namespace log {
 //! @cond false
 static constexpr const char *pstr_level_uppercase_off __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "OFF";
 static constexpr const char *pstr_level_uppercase_emerg __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "EMERG";
-static constexpr const char *pstr_level_uppercase_crit __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "CRIT";
 static constexpr const char *pstr_level_uppercase_alert __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "ALERT";
+static constexpr const char *pstr_level_uppercase_crit __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "CRIT";
 static constexpr const char *pstr_level_uppercase_err __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "ERR";
 static constexpr const char *pstr_level_uppercase_warning __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "WARNING";
 static constexpr const char *pstr_level_uppercase_notice __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "NOTICE";
@@ -43,11 +44,11 @@ static constexpr const char *pstr_level_uppercase_debug __attribute__((__aligned
 static constexpr const char *pstr_level_uppercase_trace __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "TRACE";
 static constexpr const char *pstr_level_uppercase_all __attribute__((__aligned__(PSTR_ALIGN))) PROGMEM = "ALL";
 
-static const __FlashStringHelper *log_level_uppercase[(int)Level::ALL - (int)Level::OFF + 1] = {
+static const std::array<const __FlashStringHelper *,NUM_LEVELS> log_level_uppercase = {{
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_off),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_emerg),
-	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_crit),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_alert),
+	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_crit),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_err),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_warning),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_notice),
@@ -55,13 +56,17 @@ static const __FlashStringHelper *log_level_uppercase[(int)Level::ALL - (int)Lev
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_debug),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_trace),
 	reinterpret_cast<const __FlashStringHelper *>(pstr_level_uppercase_all)
-};
+}};
 //! @endcond
 
 const __FlashStringHelper *format_level_uppercase(Level level) {
 	return log_level_uppercase[(int)level + 1];
 }
 
+const std::array<const __FlashStringHelper *,NUM_LEVELS> &level_names_uppercase() {
+	return log_level_uppercase;
+}
+
 } // namespace log
 
 } // namespace uuid
@@ -20,37 +20,134 @@
 
 #include <Arduino.h>
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 namespace uuid {
 
 namespace log {
 
-std::string format_timestamp_ms(uint64_t timestamp_ms, unsigned int days_width) {
-	unsigned long days;
-	unsigned int hours, minutes, seconds, milliseconds;
+//! @cond false
+static const char two_digits[] PROGMEM =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static inline char *format_two_digits(char *text, unsigned int value) {
+	::memcpy_P(text, &two_digits[value * 2], 2);
+	return text + 2;
+}
 
-	days = timestamp_ms / 86400000UL;
-	timestamp_ms %= 86400000UL;
+/*
+ * Format the days part with leading zeros, in the format "d+HH:mm:".
+ * Returns the end of the text.
+ */
+static char *format_minute_prefix(char *text, uint64_t days, unsigned int hours, unsigned int minutes, unsigned int days_width) {
+	std::array<char,12> digits;
+	size_t length = 0;
+
+	do {
+		digits[length++] = '0' + (days % 10);
+		days /= 10;
+	} while (days > 0 && length < digits.size());
+
+	days_width = std::min(days_width, (unsigned int)digits.size());
+	while (length < days_width) {
+		digits[length++] = '0';
+	}
+
+	while (length > 0) {
+		*text++ = digits[--length];
+	}
+
+	*text++ = '+';
+	text = format_two_digits(text, hours);
+	*text++ = ':';
+	text = format_two_digits(text, minutes);
+	*text++ = ':';
+	return text;
+}
 
-	hours = timestamp_ms / 3600000UL;
-	timestamp_ms %= 3600000UL;
+/*
+ * Format the seconds part, in the format "ss.SSS". Returns the end of
+ * the text.
+ */
+static char *format_seconds(char *text, unsigned long milliseconds) {
+	text = format_two_digits(text, milliseconds / 1000UL);
+	milliseconds %= 1000UL;
+	*text++ = '.';
+	*text++ = '0' + (milliseconds / 100U);
+	return format_two_digits(text, milliseconds % 100U);
+}
+
+static size_t copy_text(char *buffer, size_t size, const char *text, size_t length) {
+	if (size == 0) {
+		return 0;
+	}
+
+	length = std::min(length, size - 1);
+	std::memcpy(buffer, text, length);
+	buffer[length] = '\0';
+	return length;
+}
+//! @endcond
 
-	minutes = timestamp_ms / 60000UL;
-	timestamp_ms %= 60000UL;
+size_t format_timestamp_ms(char *buffer, size_t size, uint64_t timestamp_ms, unsigned int days_width) {
+	std::array<char,MAX_TIMESTAMP_MS_LENGTH> text;
+	uint64_t days = timestamp_ms / 86400000UL;
+	unsigned long remaining = timestamp_ms % 86400000UL;
+	unsigned int hours = remaining / 3600000UL;
+	unsigned int minutes;
+	char *end;
+
+	remaining %= 3600000UL;
+	minutes = remaining / 60000UL;
+	remaining %= 60000UL;
+
+	end = format_minute_prefix(text.data(), days, hours, minutes, days_width);
+	end = format_seconds(end, remaining);
+
+	return copy_text(buffer, size, text.data(), end - text.data());
+}
+
+std::string format_timestamp_ms(uint64_t timestamp_ms, unsigned int days_width) {
+	std::array<char,MAX_TIMESTAMP_MS_LENGTH + 1> text;
+	size_t length = format_timestamp_ms(text.data(), text.size(), timestamp_ms, days_width);
+
+	return std::string(text.data(), length);
+}
+
+TimestampFormatter::TimestampFormatter(unsigned int days_width) : days_width_(days_width) {
+}
 
-	seconds = timestamp_ms / 1000UL;
-	timestamp_ms %= 1000UL;
+size_t TimestampFormatter::format(char *buffer, size_t size, uint64_t timestamp_ms) {
+	if (prefix_length_ == 0 || timestamp_ms < minute_start_ms_ || timestamp_ms - minute_start_ms_ >= 60000UL) {
+		uint64_t days = timestamp_ms / 86400000UL;
+		unsigned long remaining = timestamp_ms % 86400000UL;
+		unsigned int hours = remaining / 3600000UL;
+		unsigned int minutes;
 
-	milliseconds = timestamp_ms;
+		remaining %= 3600000UL;
+		minutes = remaining / 60000UL;
+		remaining %= 60000UL;
 
-	std::array<char,12 + 1 /* days */ + 2 + 1 /* hours */ + 2 + 1 /* minutes */ + 2 + 1 /* seconds */ + 3 /* milliseconds */ + 1> text;
+		minute_start_ms_ = timestamp_ms - remaining;
+		prefix_length_ = format_minute_prefix(text_.data(), days, hours, minutes, days_width_) - text_.data();
+	}
 
-	snprintf_P(text.data(), text.size(), PSTR("%0*lu+%02u:%02u:%02u.%03u"), std::min(days_width, 12U), days, hours, minutes, seconds, milliseconds);
+	char *end = format_seconds(&text_[prefix_length_], timestamp_ms - minute_start_ms_);
 
-	return text.data();
+	return copy_text(buffer, size, text_.data(), end - text_.data());
 }
 
 } // namespace log
@@ -18,26 +18,35 @@
 
 #include <uuid/log.h>
 
+#include <array>
 #include <vector>
 
 namespace uuid {
 
 namespace log {
 
+//! @cond false
+static const std::array<Level,NUM_LEVELS> all_levels_ = {{
+	Level::OFF,
+	Level::EMERG,
+	Level::ALERT,
+	Level::CRIT,
+	Level::ERR,
+	Level::WARNING,
+	Level::NOTICE,
+	Level::INFO,
+	Level::DEBUG,
+	Level::TRACE,
+	Level::ALL
+}};
+//! @endcond
+
+const std::array<Level,NUM_LEVELS> &all_levels() {
+	return all_levels_;
+}
+
 std::vector<Level> levels() {
-	return {
-		Level::OFF,
-		Level::EMERG,
-		Level::ALERT,
-		Level::CRIT,
-		Level::ERR,
-		Level::WARNING,
-		Level::NOTICE,
-		Level::INFO,
-		Level::DEBUG,
-		Level::TRACE,
-		Level::ALL
-	};
+	return {all_levels_.begin(), all_levels_.end()};
 }
 
 } // namespace log
@@ -18,6 +18,7 @@
 
 #include <uuid/log.h>
 
+#include <string>
 #include <vector>
 
 #include <uuid/common.h>
@@ -27,19 +28,15 @@ namespace uuid {
 namespace log {
 
 std::vector<std::string> levels_lowercase() {
-	return {
-		uuid::read_flash_string(format_level_lowercase(Level::OFF)),
-		uuid::read_flash_string(format_level_lowercase(Level::EMERG)),
-		uuid::read_flash_string(format_level_lowercase(Level::ALERT)),
-		uuid::read_flash_string(format_level_lowercase(Level::CRIT)),
-		uuid::read_flash_string(format_level_lowercase(Level::ERR)),
-		uuid::read_flash_string(format_level_lowercase(Level::WARNING)),
-		uuid::read_flash_string(format_level_lowercase(Level::NOTICE)),
-		uuid::read_flash_string(format_level_lowercase(Level::INFO)),
-		uuid::read_flash_string(format_level_lowercase(Level::DEBUG)),
-		uuid::read_flash_string(format_level_lowercase(Level::TRACE)),
-		uuid::read_flash_string(format_level_lowercase(Level::ALL))
-	};
+	std::vector<std::string> names;
+
+	names.reserve(NUM_LEVELS);
+
+	for (auto name : level_names_lowercase()) {
+		names.push_back(uuid::read_flash_string(name));
+	}
+
+	return names;
 }
 
 } // namespace log
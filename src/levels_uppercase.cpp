@@ -18,6 +18,7 @@
 
 #include <uuid/log.h>
 
+#include <string>
 #include <vector>
 
 #include <uuid/common.h>
@@ -27,19 +28,15 @@ namespace uuid {
 namespace log {
 
 std::vector<std::string> levels_uppercase() {
-	return {
-		uuid::read_flash_string(format_level_uppercase(Level::OFF)),
-		uuid::read_flash_string(format_level_uppercase(Level::EMERG)),
-		uuid::read_flash_string(format_level_uppercase(Level::ALERT)),
-		uuid::read_flash_string(format_level_uppercase(Level::CRIT)),
-		uuid::read_flash_string(format_level_uppercase(Level::ERR)),
-		uuid::read_flash_string(format_level_uppercase(Level::WARNING)),
-		uuid::read_flash_string(format_level_uppercase(Level::NOTICE)),
-		uuid::read_flash_string(format_level_uppercase(Level::INFO)),
-		uuid::read_flash_string(format_level_uppercase(Level::DEBUG)),
-		uuid::read_flash_string(format_level_uppercase(Level::TRACE)),
-		uuid::read_flash_string(format_level_uppercase(Level::ALL))
-	};
+	std::vector<std::string> names;
+
+	names.reserve(NUM_LEVELS);
+
+	for (auto name : level_names_uppercase()) {
+		names.push_back(uuid::read_flash_string(name));
+	}
+
+	return names;
 }
 
 } // namespace log
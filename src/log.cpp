@@ -20,16 +20,22 @@
 
 #include <Arduino.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdarg>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <list>
-#include <map>
 #include <memory>
 #if UUID_LOG_THREAD_SAFE
 # include <mutex>
 #endif
 #include <string>
+#if UUID_LOG_THREAD_SAFE
+# include <thread>
+#endif
 #include <utility>
 #include <vector>
 
@@ -38,6 +44,13 @@ namespace uuid {
 namespace log {
 
 std::atomic<Level> Logger::global_level_{Level::OFF};
+std::array<std::atomic<Level>,NUM_FACILITIES> Logger::facility_levels_{{
+	{Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF},
+	{Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF},
+	{Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF},
+	{Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF}, {Level::OFF},
+}};
+std::atomic<uint32_t> Logger::generation_{1};
 #if UUID_LOG_THREAD_SAFE
 std::mutex Logger::mutex_;
 #endif
@@ -53,63 +66,303 @@ static Level constrain_level(Level level) {
 }
 //! @endcond
 
-Message::Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const std::string &&text)
-		: uptime_ms(uptime_ms), level(level), facility(facility), name(name), text(std::move(text)) {
-}
+//! @cond false
+struct Logger::RateLimit {
+#if UUID_LOG_THREAD_SAFE
+	std::mutex mutex;
+#endif
+	unsigned int rate{0}; /* Messages per second */
+	unsigned int burst{0}; /* Maximum number of tokens */
+	uint64_t tokens{0}; /* Thousandths of a message */
+	uint64_t updated_ms{0};
+	unsigned long pending{0}; /* Suppressed since the last summary */
+	unsigned long suppressed{0};
+};
+//! @endcond
 
 Logger::Logger(const __FlashStringHelper *name, Facility facility)
 		: name_(name), facility_(facility) {
+	/* Call sites may have cached a decision for a previous logger at the same address. */
+	generation_++;
+};
+
+Logger::~Logger() {
+	if (registered_) {
+		unregister_logger(this);
+	}
+
+	delete rate_limit_.load();
+}
+
+void Logger::rate_limit(unsigned int rate, unsigned int burst) {
+	RateLimit *limit = rate_limit_.load(std::memory_order_acquire);
+
+	if (!limit) {
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+		limit = rate_limit_.load(std::memory_order_acquire);
+		if (!limit) {
+			limit = new RateLimit;
+			rate_limit_.store(limit, std::memory_order_release);
+		}
+	}
+
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{limit->mutex};
+#endif
+
+	limit->rate = rate;
+	limit->burst = std::max(1U, burst);
+	limit->tokens = (uint64_t)limit->burst * 1000;
+	limit->updated_ms = get_uptime_ms();
+}
+
+unsigned long Logger::suppressed_messages() const {
+	RateLimit *limit = rate_limit_.load(std::memory_order_acquire);
+
+	if (!limit) {
+		return 0;
+	}
+
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{limit->mutex};
+#endif
+
+	return limit->suppressed;
+}
+
+bool Logger::rate_limited(Level level, Facility facility) const {
+	RateLimit *limit = rate_limit_.load(std::memory_order_acquire);
+	unsigned long pending;
 
+	if (!limit) {
+		return false;
+	}
+
+	{
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{limit->mutex};
+#endif
+
+		if (limit->rate == 0) {
+			return false;
+		}
+
+		const uint64_t now_ms = get_uptime_ms();
+		const uint64_t maximum = (uint64_t)limit->burst * 1000;
+		const uint64_t elapsed_ms = std::min(now_ms - limit->updated_ms, maximum);
+
+		limit->updated_ms = now_ms;
+		limit->tokens = std::min(limit->tokens + elapsed_ms * limit->rate, maximum);
+
+		if (limit->tokens < 1000) {
+			limit->pending++;
+			limit->suppressed++;
+			return true;
+		}
+
+		limit->tokens -= 1000;
+		pending = limit->pending;
+		limit->pending = 0;
+	}
+
+	if (pending > 0) {
+		std::array<char, 40> text;
+		int ret = snprintf_P(text.data(), text.size(), PSTR("Suppressed %lu messages"), pending);
+
+		if (ret > 0) {
+			dispatch(level, facility, text.data(), std::min((size_t)ret, text.size() - 1));
+		}
+	}
+
+	return false;
+}
+
+//! @cond false
+struct Handler::Handlers {
+	std::vector<std::pair<Handler*,Level>> registered; /* Sorted by handler */
+	std::vector<std::pair<Handler*,uint32_t>> dispatch; /* Sorted by level, highest first, with facilities */
+	std::array<size_t, Level::ALL + 1> interested{}; /* Number of dispatch handlers for each level */
 };
 
-std::shared_ptr<std::map<Handler*,Level>>& Logger::registered_handlers() {
-	static std::shared_ptr<std::map<Handler*,Level>> handlers = std::make_shared<std::map<Handler*,Level>>();
+/*
+ * The registered handlers are never modified after they've been
+ * published. Changes are made to a new copy which replaces the current
+ * one, so that dispatch() can use the current copy without locking a
+ * mutex.
+ *
+ * Each dispatch() call is counted as a reader of the current epoch
+ * while it uses the handlers. The counts are split into stripes so that
+ * threads don't all modify the same count. When a new copy is
+ * published, the epoch is changed and the readers of the previous epoch
+ * are waited for before the previous copy is deleted. Readers that
+ * start after the epoch changes will use the new copy.
+ */
+struct Handler::Registry {
+#if UUID_LOG_THREAD_SAFE
+	static constexpr size_t STRIPES = 16;
+
+	struct Stripe {
+		std::atomic<unsigned long> readers[2];
+		char padding[64 - 2 * sizeof(std::atomic<unsigned long>)];
+	};
+
+	class Reader {
+	public:
+		explicit inline Reader(Registry &registry) {
+			Stripe &stripe = registry.stripes[Registry::stripe()];
+
+			do {
+				const unsigned int epoch = registry.epoch.load();
+
+				readers_ = &stripe.readers[epoch];
+				readers_->fetch_add(1);
+
+				if (registry.epoch.load() == epoch) {
+					break;
+				}
+
+				readers_->fetch_sub(1);
+			} while (true);
+
+			handlers_ = registry.handlers.load();
+		}
+
+		inline ~Reader() {
+			readers_->fetch_sub(1);
+		}
 
-	return handlers;
+		inline const Handlers &handlers() const { return *handlers_; }
+
+	private:
+		std::atomic<unsigned long> *readers_;
+		const Handlers *handlers_;
+	};
+
+	static inline size_t stripe() {
+		static std::atomic<size_t> next{0};
+		static thread_local size_t stripe = next++ % STRIPES;
+
+		return stripe;
+	}
+#else
+	class Reader {
+	public:
+		explicit inline Reader(Registry &registry) : handlers_(registry.handlers.load()) {
+		}
+
+		inline const Handlers &handlers() const { return *handlers_; }
+
+	private:
+		const Handlers *handlers_;
+	};
+#endif
+
+	Registry() : handlers(new Handlers) {
+	}
+
+	~Registry() {
+		delete handlers.load();
+	}
+
+	static inline std::vector<std::pair<Handler*,Level>>::iterator find(Handlers &handlers, Handler *handler) {
+		return std::lower_bound(handlers.registered.begin(), handlers.registered.end(), handler,
+			[] (const std::pair<Handler*,Level> &item, Handler *value) { return std::less<Handler*>()(item.first, value); });
+	}
+
+	std::atomic<const Handlers*> handlers;
+#if UUID_LOG_THREAD_SAFE
+	std::atomic<unsigned int> epoch{0};
+	std::array<Stripe, STRIPES> stripes{};
+#endif
+};
+//! @endcond
+
+std::shared_ptr<Handler::Registry>& Logger::registered_handlers() {
+	static std::shared_ptr<Handler::Registry> registry = std::make_shared<Handler::Registry>();
+
+	return registry;
 }
 
 void Logger::register_handler(Handler *handler, Level level) {
+	register_handler(handler, level, ALL_FACILITIES);
+}
+
+void Logger::register_handler(Handler *handler, Level level, uint32_t facilities) {
 #if UUID_LOG_THREAD_SAFE
 	std::lock_guard<std::mutex> lock{mutex_};
 #endif
-	auto& handlers = registered_handlers();
+	auto& registry = registered_handlers();
+	std::unique_ptr<Handler::Handlers> handlers{new Handler::Handlers(*registry->handlers.load())};
+
+	auto it = Handler::Registry::find(*handlers, handler);
+
+	if (it != handlers->registered.end() && it->first == handler) {
+		it->second = level;
+	} else {
+		handlers->registered.emplace(it, handler, level);
+	}
 
-	handler->handlers_ = handlers;
-	(*handlers)[handler] = level;
-	refresh_log_level();
+	handler->handlers_ = registry;
+	handler->level_ = level;
+	handler->facilities_ = facilities & ALL_FACILITIES;
+	publish_handlers(*registry, std::move(handlers));
 };
 
 void Logger::unregister_handler(Handler *handler) {
-	auto handlers = handler->handlers_.lock();
+	auto registry = handler->handlers_.lock();
 
-	if (handlers) {
+	if (registry) {
 #if UUID_LOG_THREAD_SAFE
 		std::lock_guard<std::mutex> lock{mutex_};
 #endif
+		std::unique_ptr<Handler::Handlers> handlers{new Handler::Handlers(*registry->handlers.load())};
+		auto it = Handler::Registry::find(*handlers, handler);
 
-		if (handlers->erase(handler)) {
-			refresh_log_level();
+		if (it != handlers->registered.end() && it->first == handler) {
+			handlers->registered.erase(it);
+			handler->level_ = Level::OFF;
+			publish_handlers(*registry, std::move(handlers));
 		}
 	}
 };
 
 Level Logger::get_log_level(const Handler *handler) {
+	return handler->level_;
+}
+
+uint32_t Logger::get_facilities(const Handler *handler) {
+	return handler->facilities_;
+}
+
+/* Mutex already locked by caller. */
+void Logger::publish_handlers(Handler::Registry &registry, std::unique_ptr<Handler::Handlers> handlers) {
+	refresh_log_level(*handlers);
+
+	std::unique_ptr<const Handler::Handlers> previous{registry.handlers.exchange(handlers.release())};
+
+	wait_for_dispatch(registry);
+}
+
+/* Mutex already locked by caller. */
+void Logger::wait_for_dispatch(Handler::Registry &registry) {
 #if UUID_LOG_THREAD_SAFE
-	std::lock_guard<std::mutex> lock{mutex_};
-#endif
-	auto& handlers = registered_handlers();
+	const unsigned int epoch = registry.epoch.load();
 
-	const auto level = handlers->find(const_cast<Handler*>(handler));
+	registry.epoch.store(epoch ^ 1);
 
-	if (level != handlers->end()) {
-		return level->second;
+	for (auto &stripe : registry.stripes) {
+		while (stripe.readers[epoch].load() != 0) {
+			std::this_thread::yield();
+		}
 	}
-
-	return Level::OFF;
+#endif
 }
 
 void Logger::emerg(const char *format, ...) const {
-	if (enabled(Level::EMERG)) {
+	if (enabled(Level::EMERG) && !rate_limited(Level::EMERG, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -119,7 +372,7 @@ void Logger::emerg(const char *format, ...) const {
 };
 
 void Logger::emerg(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::EMERG)) {
+	if (enabled(Level::EMERG) && !rate_limited(Level::EMERG, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -129,7 +382,7 @@ void Logger::emerg(const __FlashStringHelper *format, ...) const {
 };
 
 void Logger::crit(const char *format, ...) const {
-	if (enabled(Level::CRIT)) {
+	if (enabled(Level::CRIT) && !rate_limited(Level::CRIT, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -139,7 +392,7 @@ void Logger::crit(const char *format, ...) const {
 };
 
 void Logger::crit(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::CRIT)) {
+	if (enabled(Level::CRIT) && !rate_limited(Level::CRIT, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -149,7 +402,7 @@ void Logger::crit(const __FlashStringHelper *format, ...) const {
 };
 
 void Logger::alert(const char *format, ...) const {
-	if (enabled(Level::ALERT)) {
+	if (enabled(Level::ALERT) && !rate_limited(Level::ALERT, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -159,7 +412,7 @@ void Logger::alert(const char *format, ...) const {
 };
 
 void Logger::alert(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::ALERT)) {
+	if (enabled(Level::ALERT) && !rate_limited(Level::ALERT, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -168,7 +421,7 @@ void Logger::alert(const __FlashStringHelper *format, ...) const {
 	}
 };
 void Logger::err(const char *format, ...) const {
-	if (enabled(Level::ERR)) {
+	if (enabled(Level::ERR) && !rate_limited(Level::ERR, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -178,7 +431,7 @@ void Logger::err(const char *format, ...) const {
 };
 
 void Logger::err(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::ERR)) {
+	if (enabled(Level::ERR) && !rate_limited(Level::ERR, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -188,7 +441,7 @@ void Logger::err(const __FlashStringHelper *format, ...) const {
 };
 
 void Logger::warning(const char *format, ...) const {
-	if (enabled(Level::WARNING)) {
+	if (enabled(Level::WARNING) && !rate_limited(Level::WARNING, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -198,7 +451,7 @@ void Logger::warning(const char *format, ...) const {
 };
 
 void Logger::warning(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::WARNING)) {
+	if (enabled(Level::WARNING) && !rate_limited(Level::WARNING, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -208,7 +461,7 @@ void Logger::warning(const __FlashStringHelper *format, ...) const {
 };
 
 void Logger::notice(const char *format, ...) const {
-	if (enabled(Level::NOTICE)) {
+	if (enabled(Level::NOTICE) && !rate_limited(Level::NOTICE, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -218,7 +471,7 @@ void Logger::notice(const char *format, ...) const {
 };
 
 void Logger::notice(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::NOTICE)) {
+	if (enabled(Level::NOTICE) && !rate_limited(Level::NOTICE, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -228,7 +481,7 @@ void Logger::notice(const __FlashStringHelper *format, ...) const {
 };
 
 void Logger::info(const char *format, ...) const {
-	if (enabled(Level::INFO)) {
+	if (enabled(Level::INFO) && !rate_limited(Level::INFO, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -238,7 +491,7 @@ void Logger::info(const char *format, ...) const {
 };
 
 void Logger::info(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::INFO)) {
+	if (enabled(Level::INFO) && !rate_limited(Level::INFO, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -248,7 +501,7 @@ void Logger::info(const __FlashStringHelper *format, ...) const {
 };
 
 void Logger::debug(const char *format, ...) const {
-	if (enabled(Level::DEBUG)) {
+	if (enabled(Level::DEBUG) && !rate_limited(Level::DEBUG, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -258,7 +511,7 @@ void Logger::debug(const char *format, ...) const {
 };
 
 void Logger::debug(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::DEBUG)) {
+	if (enabled(Level::DEBUG) && !rate_limited(Level::DEBUG, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -268,7 +521,7 @@ void Logger::debug(const __FlashStringHelper *format, ...) const {
 };
 
 void Logger::trace(const char *format, ...) const {
-	if (enabled(Level::TRACE)) {
+	if (enabled(Level::TRACE) && !rate_limited(Level::TRACE, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -278,7 +531,7 @@ void Logger::trace(const char *format, ...) const {
 };
 
 void Logger::trace(const __FlashStringHelper *format, ...) const {
-	if (enabled(Level::TRACE)) {
+	if (enabled(Level::TRACE) && !rate_limited(Level::TRACE, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -290,7 +543,7 @@ void Logger::trace(const __FlashStringHelper *format, ...) const {
 void Logger::log(Level level, const char *format, ...) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
+	if (enabled(level) && !rate_limited(level, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -302,7 +555,7 @@ void Logger::log(Level level, const char *format, ...) const {
 void Logger::log(Level level, const __FlashStringHelper *format, ...) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
+	if (enabled(level) && !rate_limited(level, facility_)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -314,7 +567,7 @@ void Logger::log(Level level, const __FlashStringHelper *format, ...) const {
 void Logger::log(Level level, Facility facility, const char *format, ...) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
+	if (enabled(level, facility) && !rate_limited(level, facility)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -326,7 +579,7 @@ void Logger::log(Level level, Facility facility, const char *format, ...) const
 void Logger::log(Level level, Facility facility, const __FlashStringHelper *format, ...) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
+	if (enabled(level, facility) && !rate_limited(level, facility)) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -338,7 +591,7 @@ void Logger::log(Level level, Facility facility, const __FlashStringHelper *form
 void Logger::vlog(Level level, const char *format, va_list ap) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
+	if (enabled(level) && !rate_limited(level, facility_)) {
 		vlog_internal(level, facility_, format, ap);
 	}
 }
@@ -346,7 +599,7 @@ void Logger::vlog(Level level, const char *format, va_list ap) const {
 void Logger::vlog(Level level, Facility facility, const char *format, va_list ap) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
+	if (enabled(level, facility) && !rate_limited(level, facility)) {
 		vlog_internal(level, facility, format, ap);
 	}
 }
@@ -354,7 +607,7 @@ void Logger::vlog(Level level, Facility facility, const char *format, va_list ap
 void Logger::vlog(Level level, const __FlashStringHelper *format, va_list ap) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
+	if (enabled(level) && !rate_limited(level, facility_)) {
 		vlog_internal(level, facility_, format, ap);
 	}
 }
@@ -362,29 +615,31 @@ void Logger::vlog(Level level, const __FlashStringHelper *format, va_list ap) co
 void Logger::vlog(Level level, Facility facility, const __FlashStringHelper *format, va_list ap) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
+	if (enabled(level, facility) && !rate_limited(level, facility)) {
 		vlog_internal(level, facility, format, ap);
 	}
 }
 
 void Logger::vlog_internal(Level level, Facility facility, const char *format, va_list ap) const {
-	std::vector<char> text(MAX_LOG_LENGTH + 1);
+	std::array<char, MAX_LOG_LENGTH + 1> text;
+	int ret = vsnprintf(text.data(), text.size(), format, ap);
 
-	if (vsnprintf(text.data(), text.size(), format, ap) <= 0) {
+	if (ret <= 0) {
 		return;
 	}
 
-	dispatch(level, facility, text);
+	dispatch(level, facility, text.data(), std::min((size_t)ret, text.size() - 1));
 }
 
 void Logger::vlog_internal(Level level, Facility facility, const __FlashStringHelper *format, va_list ap) const {
-	std::vector<char> text(MAX_LOG_LENGTH + 1);
+	std::array<char, MAX_LOG_LENGTH + 1> text;
+	int ret = vsnprintf_P(text.data(), text.size(), reinterpret_cast<PGM_P>(format), ap);
 
-	if (vsnprintf_P(text.data(), text.size(), reinterpret_cast<PGM_P>(format), ap) <= 0) {
+	if (ret <= 0) {
 		return;
 	}
 
-	dispatch(level, facility, text);
+	dispatch(level, facility, text.data(), std::min((size_t)ret, text.size() - 1));
 }
 
 void Logger::logp(Level level, const char *text) const {
@@ -394,42 +649,90 @@ void Logger::logp(Level level, const char *text) const {
 void Logger::logp(Level level, Facility facility, const char *text) const {
 	level = constrain_level(level);
 
-	if (enabled(level)) {
-		std::shared_ptr<Message> message = std::make_shared<Message>(get_uptime_ms(), level, facility, name_, text);
-		dispatch(message);
+	if (enabled(level, facility) && !rate_limited(level, facility)) {
+		dispatch(Message::create(get_uptime_ms(), level, facility, name_, text, ::strlen(text)));
 	}
 }
 
-void Logger::dispatch(Level level, Facility facility, std::vector<char> &text) const {
-	std::shared_ptr<Message> message = std::make_shared<Message>(get_uptime_ms(), level, facility, name_, text.data());
-	text.resize(0);
-	text.shrink_to_fit();
-	dispatch(message);
+void Logger::log_deferred(Level level, Facility facility, const MessageFormat &format) const {
+	level = constrain_level(level);
+
+	if (enabled(level, facility) && !rate_limited(level, facility)) {
+		dispatch(Message::create(get_uptime_ms(), level, facility, name_, format));
+	}
+}
+
+void Logger::dispatch(Level level, Facility facility, const char *text, size_t length) const {
+	dispatch(Message::create(get_uptime_ms(), level, facility, name_, text, length));
 }
 
 inline void Logger::dispatch(const std::shared_ptr<Message> &message) const {
-#if UUID_LOG_THREAD_SAFE
-	std::lock_guard<std::mutex> lock{mutex_};
-#endif
+	if (!message) {
+		return;
+	}
 
-	for (auto &handler : *registered_handlers()) {
-		if (message->level <= handler.second) {
-			*handler.first << message;
+	if (message->level < Level::EMERG || message->level > Level::ALL) {
+		return;
+	}
+
+	Handler::Registry::Reader reader{*registered_handlers()};
+	const Handler::Handlers &handlers = reader.handlers();
+	const size_t count = handlers.interested[message->level];
+	const uint32_t facility = facility_mask(message->facility);
+
+	for (size_t i = 0; i < count; i++) {
+		if (handlers.dispatch[i].second & facility) {
+			*handlers.dispatch[i].first << message;
 		}
 	}
 }
 
 /* Mutex already locked by caller. */
-void Logger::refresh_log_level() {
+void Logger::refresh_log_level(Handler::Handlers &handlers) {
+	auto registered = handlers.registered;
+	std::array<Level,NUM_FACILITIES> levels;
 	Level level = Level::OFF;
 
-	for (auto &handler : *registered_handlers()) {
+	levels.fill(Level::OFF);
+
+	std::stable_sort(registered.begin(), registered.end(),
+		[] (const std::pair<Handler*,Level> &a, const std::pair<Handler*,Level> &b) { return a.second > b.second; });
+
+	handlers.dispatch.clear();
+	handlers.interested.fill(0);
+
+	for (auto &handler : registered) {
+		const uint32_t facilities = handler.first->facilities_;
+
+		if (!facilities) {
+			continue;
+		}
+
 		if (level < handler.second) {
 			level = handler.second;
 		}
+
+		for (size_t i = 0; i < NUM_FACILITIES; i++) {
+			if ((facilities & (UINT32_C(1) << i)) && levels[i] < handler.second) {
+				levels[i] = handler.second;
+			}
+		}
+
+		if (handler.second > Level::OFF) {
+			handlers.dispatch.emplace_back(handler.first, facilities);
+
+			for (int i = Level::EMERG; i <= handler.second && i <= Level::ALL; i++) {
+				handlers.interested[i]++;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < NUM_FACILITIES; i++) {
+		facility_levels_[i] = levels[i];
 	}
 
 	global_level_ = level;
+	generation_++;
 }
 
 } // namespace log
@@ -0,0 +1,277 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if UUID_LOG_THREAD_SAFE
+# include <mutex>
+#endif
+#include <vector>
+
+namespace uuid {
+
+namespace log {
+
+//! @cond false
+struct LoggerRegistry {
+#if UUID_LOG_THREAD_SAFE
+	std::mutex mutex;
+#endif
+	std::vector<Logger*> loggers; /* Sorted by name */
+};
+
+/*
+ * Loggers may be registered and destroyed by other static objects, so
+ * the registry is never destroyed.
+ */
+static LoggerRegistry &registry() {
+	static LoggerRegistry *registry = new LoggerRegistry{};
+
+	return *registry;
+}
+
+static inline unsigned char read_char(PGM_P text, size_t offset) {
+	return pgm_read_byte(&text[offset]);
+}
+
+/* Compare two names (flash strings) */
+static int compare_names(PGM_P name1, PGM_P name2) {
+	for (size_t i = 0; ; i++) {
+		unsigned char c1 = read_char(name1, i);
+		unsigned char c2 = read_char(name2, i);
+
+		if (c1 != c2) {
+			return c1 < c2 ? -1 : 1;
+		} else if (c1 == '\0') {
+			return 0;
+		}
+	}
+}
+
+/* Compare the start of a name (flash string) with a prefix */
+static int compare_prefix(PGM_P name, const char *prefix, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		unsigned char c1 = read_char(name, i);
+		unsigned char c2 = prefix[i];
+
+		if (c1 != c2) {
+			return c1 < c2 ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+/* Match a name (flash string) against a pattern with "*" and "?" wildcards */
+static bool match_pattern(const char *pattern, size_t length, PGM_P name) {
+	size_t p = 0;
+	size_t n = 0;
+	size_t star_p = SIZE_MAX;
+	size_t star_n = 0;
+
+	while (true) {
+		unsigned char c = read_char(name, n);
+
+		if (p < length && pattern[p] == '*') {
+			star_p = ++p;
+			star_n = n;
+		} else if (p < length && c != '\0' && (pattern[p] == '?' || (unsigned char)pattern[p] == c)) {
+			p++;
+			n++;
+		} else if (p == length && c == '\0') {
+			return true;
+		} else if (star_p != SIZE_MAX && read_char(name, star_n) != '\0') {
+			/* Backtrack: let the last "*" match one more character */
+			p = star_p;
+			n = ++star_n;
+		} else {
+			return false;
+		}
+	}
+}
+
+static inline bool is_space(char c) {
+	return c == ' ' || c == '\t';
+}
+
+static void trim(const char *&text, size_t &length) {
+	while (length > 0 && is_space(text[0])) {
+		text++;
+		length--;
+	}
+	while (length > 0 && is_space(text[length - 1])) {
+		length--;
+	}
+}
+//! @endcond
+
+void Logger::register_logger(Logger *logger) {
+	auto &reg = registry();
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{reg.mutex};
+#endif
+
+	if (logger->registered_) {
+		return;
+	}
+
+	auto it = std::upper_bound(reg.loggers.begin(), reg.loggers.end(), logger,
+		[] (const Logger *a, const Logger *b) {
+			return compare_names(reinterpret_cast<PGM_P>(a->name_),
+				reinterpret_cast<PGM_P>(b->name_)) < 0;
+		});
+
+	reg.loggers.insert(it, logger);
+	logger->registered_ = true;
+}
+
+void Logger::unregister_logger(Logger *logger) {
+	auto &reg = registry();
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{reg.mutex};
+#endif
+
+	if (!logger->registered_) {
+		return;
+	}
+
+	auto it = std::find(reg.loggers.begin(), reg.loggers.end(), logger);
+
+	if (it != reg.loggers.end()) {
+		reg.loggers.erase(it);
+	}
+
+	logger->registered_ = false;
+}
+
+Logger *Logger::find_logger(const char *name) {
+	auto &reg = registry();
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{reg.mutex};
+#endif
+	const size_t length = ::strlen(name) + 1;
+
+	auto it = std::lower_bound(reg.loggers.begin(), reg.loggers.end(), name,
+		[length] (const Logger *logger, const char *name) {
+			return compare_prefix(reinterpret_cast<PGM_P>(logger->name_), name, length) < 0;
+		});
+
+	if (it != reg.loggers.end()
+			&& !compare_prefix(reinterpret_cast<PGM_P>((*it)->name_), name, length)) {
+		return *it;
+	}
+
+	return nullptr;
+}
+
+size_t Logger::configure_level(const char *pattern, Level level) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{registry().mutex};
+#endif
+
+	return configure_level(pattern, ::strlen(pattern), level);
+}
+
+/* Mutex already locked by caller. */
+size_t Logger::configure_level(const char *pattern, size_t length, Level level) {
+	auto &reg = registry();
+	size_t prefix = 0;
+	size_t count = 0;
+
+	while (prefix < length && pattern[prefix] != '*' && pattern[prefix] != '?') {
+		prefix++;
+	}
+
+	/* Only loggers with names that start with the literal prefix can match */
+	auto it = std::lower_bound(reg.loggers.begin(), reg.loggers.end(), pattern,
+		[prefix] (const Logger *logger, const char *pattern) {
+			return compare_prefix(reinterpret_cast<PGM_P>(logger->name_), pattern, prefix) < 0;
+		});
+
+	for (; it != reg.loggers.end(); ++it) {
+		PGM_P name = reinterpret_cast<PGM_P>((*it)->name_);
+
+		if (compare_prefix(name, pattern, prefix)) {
+			break;
+		}
+
+		if (match_pattern(pattern, length, name)) {
+			(*it)->level(level);
+			count++;
+		}
+	}
+
+	return count;
+}
+
+bool Logger::configure_levels(const char *spec) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{registry().mutex};
+#endif
+
+	/* Check that the whole specification is valid before applying it */
+	for (int apply = 0; apply <= 1; apply++) {
+		const char *entry = spec;
+
+		while (*entry != '\0') {
+			const char *end = ::strchr(entry, ',');
+			size_t entry_length = end ? (size_t)(end - entry) : ::strlen(entry);
+			const char *separator = static_cast<const char *>(::memchr(entry, '=', entry_length));
+			const char *pattern = "*";
+			size_t pattern_length = 1;
+			const char *name = entry;
+			size_t name_length = entry_length;
+			Level level;
+
+			if (separator) {
+				pattern = entry;
+				pattern_length = separator - entry;
+				name = separator + 1;
+				name_length = entry_length - pattern_length - 1;
+				trim(pattern, pattern_length);
+			}
+
+			trim(name, name_length);
+
+			if (name_length == 0 && !separator) {
+				/* Ignore empty entries */
+			} else if (pattern_length == 0
+					|| (!parse_level_lowercase(name, name_length, level)
+						&& !parse_level_uppercase(name, name_length, level))) {
+				return false;
+			} else if (apply) {
+				configure_level(pattern, pattern_length, level);
+			}
+
+			entry += entry_length;
+			if (*entry == ',') {
+				entry++;
+			}
+		}
+	}
+
+	return true;
+}
+
+} // namespace log
+
+} // namespace uuid
@@ -0,0 +1,414 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#if UUID_LOG_MAPPED_RING_AVAILABLE
+
+#include <Arduino.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#if UUID_LOG_THREAD_SAFE
+# include <mutex>
+#endif
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace uuid {
+
+namespace log {
+
+//! @cond false
+/*
+ * The file is only read on the same system so values are stored in
+ * native byte order.
+ */
+struct MappedRingFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_alignment;
+	uint64_t size;
+	uint8_t reserved[40];
+};
+
+struct MappedRingRecordHeader {
+	uint32_t magic;
+	uint32_t crc; /* Of the rest of the header and the name and text */
+	uint64_t sequence;
+	uint64_t uptime_ms;
+	uint16_t length; /* Of the name and text */
+	int8_t level;
+	uint8_t facility;
+	uint8_t name_length;
+	uint8_t reserved[3];
+};
+
+static_assert(sizeof(MappedRingFileHeader) == 64, "File header must be 64 bytes");
+static_assert(sizeof(MappedRingRecordHeader) == 32, "Record header must be 32 bytes");
+
+static constexpr char FILE_MAGIC[8] = { 'U', 'U', 'I', 'D', 'L', 'O', 'G', 'R' };
+static constexpr uint32_t FILE_VERSION = 1;
+static constexpr uint32_t RECORD_MAGIC = 0x52474F4C;
+static constexpr size_t RECORD_ALIGNMENT = 8;
+static constexpr size_t CRC_OFFSET = offsetof(MappedRingRecordHeader, sequence);
+static constexpr size_t MAX_NAME_LENGTH = UINT8_MAX;
+static constexpr size_t MAX_RECORD_SIZE = sizeof(MappedRingRecordHeader) + MAX_NAME_LENGTH + Logger::MAX_LOG_LENGTH + RECORD_ALIGNMENT;
+
+static_assert(sizeof(MappedRingFileHeader) + MAX_RECORD_SIZE <= MappedRingHandler::MIN_FILE_SIZE,
+	"The minimum file size must be large enough for any record");
+
+static const std::array<uint32_t, 256> &crc32_table() {
+	static const std::array<uint32_t, 256> table = [] {
+		std::array<uint32_t, 256> values{};
+
+		for (uint32_t i = 0; i < values.size(); i++) {
+			uint32_t value = i;
+
+			for (unsigned int bit = 0; bit < 8; bit++) {
+				value = (value >> 1) ^ ((value & 1) ? 0xEDB88320 : 0);
+			}
+
+			values[i] = value;
+		}
+
+		return values;
+	}();
+
+	return table;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t length) {
+	const auto &table = crc32_table();
+
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static inline size_t record_size(size_t length) {
+	return (sizeof(MappedRingRecordHeader) + length + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+static bool valid_file_header(const uint8_t *data, size_t size) {
+	MappedRingFileHeader header;
+
+	if (size < sizeof(header)) {
+		return false;
+	}
+
+	::memcpy(&header, data, sizeof(header));
+
+	return !::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC))
+		&& header.version == FILE_VERSION
+		&& header.record_alignment == RECORD_ALIGNMENT
+		&& header.size == size;
+}
+
+static bool valid_record(const uint8_t *data, size_t size, size_t position, MappedRingRecordHeader &header) {
+	if (size - position < sizeof(header)) {
+		return false;
+	}
+
+	::memcpy(&header, &data[position], sizeof(header));
+
+	if (header.magic != RECORD_MAGIC
+			|| header.name_length > header.length
+			|| (size_t)(header.length - header.name_length) > Logger::MAX_LOG_LENGTH
+			|| header.level < Level::EMERG || header.level > Level::TRACE
+			|| header.facility > Facility::LOCAL7
+			|| size - position - sizeof(header) < header.length) {
+		return false;
+	}
+
+	uint32_t crc = crc32(0, &data[position + CRC_OFFSET], sizeof(header) - CRC_OFFSET + header.length);
+
+	return crc == header.crc;
+}
+
+/*
+ * Find all valid records, in sequence order. Records that have been
+ * partially overwritten fail their checksum, so the scan continues at
+ * the next aligned position until it finds a valid record.
+ */
+static std::vector<std::pair<uint64_t, size_t>> scan_records(const uint8_t *data, size_t size) {
+	std::vector<std::pair<uint64_t, size_t>> records;
+	size_t position = sizeof(MappedRingFileHeader);
+	MappedRingRecordHeader header;
+
+	while (position < size) {
+		if (valid_record(data, size, position, header)) {
+			records.emplace_back(header.sequence, position);
+			position += record_size(header.length);
+		} else {
+			position += RECORD_ALIGNMENT;
+		}
+	}
+
+	std::sort(records.begin(), records.end());
+	return records;
+}
+//! @endcond
+
+MappedRingHandler::~MappedRingHandler() {
+	Logger::unregister_handler(this);
+	close();
+}
+
+bool MappedRingHandler::open(const char *filename, size_t size) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	close_locked();
+
+	if (size < MIN_FILE_SIZE) {
+		return false;
+	}
+
+	int fd = ::open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	struct stat st;
+
+	if (fd < 0) {
+		return false;
+	}
+
+	if (::fstat(fd, &st) || ((size_t)st.st_size != size && ::ftruncate(fd, size))) {
+		::close(fd);
+		return false;
+	}
+
+	void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	::close(fd);
+
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	data_ = static_cast<uint8_t *>(data);
+	size_ = size;
+	position_ = sizeof(MappedRingFileHeader);
+	sequence_ = 1;
+
+	if (valid_file_header(data_, size_)) {
+		auto records = scan_records(data_, size_);
+
+		if (!records.empty()) {
+			MappedRingRecordHeader header;
+
+			::memcpy(&header, &data_[records.back().second], sizeof(header));
+			position_ = records.back().second + record_size(header.length);
+			sequence_ = header.sequence + 1;
+		}
+	} else {
+		MappedRingFileHeader header{};
+
+		::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+		header.version = FILE_VERSION;
+		header.record_alignment = RECORD_ALIGNMENT;
+		header.size = size_;
+
+		::memset(data_, 0, size_);
+		::memcpy(data_, &header, sizeof(header));
+	}
+
+	return true;
+}
+
+void MappedRingHandler::close() {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	close_locked();
+}
+
+/* Mutex already locked by caller. */
+void MappedRingHandler::close_locked() {
+	if (data_) {
+		::munmap(data_, size_);
+		data_ = nullptr;
+		size_ = 0;
+	}
+}
+
+bool MappedRingHandler::is_open() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	return data_ != nullptr;
+}
+
+void MappedRingHandler::sync() {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	if (data_) {
+		::msync(data_, size_, MS_SYNC);
+	}
+}
+
+void MappedRingHandler::operator<<(std::shared_ptr<Message> message) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	if (!data_) {
+		return;
+	}
+
+	MappedRingRecordHeader header{};
+	size_t name_length = ::strlen_P(reinterpret_cast<PGM_P>(message->name));
+	size_t text_length = message->text.length();
+
+	if (name_length > MAX_NAME_LENGTH) {
+		name_length = MAX_NAME_LENGTH;
+	}
+
+	if (text_length > Logger::MAX_LOG_LENGTH) {
+		text_length = Logger::MAX_LOG_LENGTH;
+	}
+
+	header.magic = RECORD_MAGIC;
+	header.sequence = sequence_++;
+	header.uptime_ms = message->uptime_ms;
+	header.length = name_length + text_length;
+	header.level = message->level;
+	header.facility = message->facility;
+	header.name_length = name_length;
+
+	const size_t size = record_size(header.length);
+
+	if (size_ - position_ < size) {
+		position_ = sizeof(MappedRingFileHeader);
+	}
+
+	uint8_t *record = &data_[position_];
+	uint8_t *payload = &record[sizeof(header)];
+
+	/*
+	 * The header is written last so that a record that is interrupted
+	 * while it is being written will fail its checksum.
+	 */
+	::memcpy_P(payload, reinterpret_cast<PGM_P>(message->name), name_length);
+	::memcpy(&payload[name_length], message->text.c_str(), text_length);
+
+	header.crc = crc32(0, reinterpret_cast<const uint8_t *>(&header) + CRC_OFFSET, sizeof(header) - CRC_OFFSET);
+	header.crc = crc32(header.crc, payload, header.length);
+
+	::memcpy(record, &header, sizeof(header));
+	position_ += size;
+}
+
+bool MappedRingReader::open(const char *filename) {
+	int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+
+	data_.clear();
+	records_.clear();
+	names_.clear();
+
+	if (fd < 0) {
+		return false;
+	}
+
+	char buffer[4096];
+	ssize_t len;
+
+	while ((len = ::read(fd, buffer, sizeof(buffer))) > 0) {
+		data_.append(buffer, len);
+	}
+
+	::close(fd);
+
+	const uint8_t *data = reinterpret_cast<const uint8_t *>(data_.data());
+
+	if (len < 0 || !valid_file_header(data, data_.size())) {
+		data_.clear();
+		return false;
+	}
+
+	for (auto &record : scan_records(data, data_.size())) {
+		records_.push_back(record.second);
+	}
+
+	return true;
+}
+
+size_t MappedRingReader::read(Handler &handler, size_t count) {
+	size_t start = records_.size() > count ? records_.size() - count : 0;
+	size_t delivered = 0;
+
+	for (size_t i = start; i < records_.size(); i++) {
+		MappedRingRecordHeader header;
+		const char *payload = &data_[records_[i] + sizeof(header)];
+		const char *name = nullptr;
+
+		::memcpy(&header, &data_[records_[i]], sizeof(header));
+
+		for (auto &existing : names_) {
+			if (::strlen(existing.get()) == header.name_length
+					&& !::memcmp(existing.get(), payload, header.name_length)) {
+				name = existing.get();
+				break;
+			}
+		}
+
+		if (!name) {
+			std::unique_ptr<char[]> copy{new char[header.name_length + 1]};
+
+			::memcpy(copy.get(), payload, header.name_length);
+			copy[header.name_length] = '\0';
+			name = copy.get();
+			names_.push_back(std::move(copy));
+		}
+
+		auto message = Message::create(header.uptime_ms,
+			static_cast<Level>(header.level),
+			static_cast<Facility>(header.facility),
+			reinterpret_cast<const __FlashStringHelper *>(name),
+			&payload[header.name_length], header.length - header.name_length);
+
+		if (message) {
+			handler << std::move(message);
+			delivered++;
+		}
+	}
+
+	return delivered;
+}
+
+} // namespace log
+
+} // namespace uuid
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2019,2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+namespace uuid {
+
+namespace log {
+
+struct Message::Allocation {
+	size_t storage_size; /* Size of the storage for the text or format string arguments */
+	void *slot; /* Storage from the pool, if available */
+	size_t size; /* Size of the allocation, including padding but not the storage */
+	char *storage; /* Storage for the text or format string arguments */
+};
+
+/*
+ * The shared pointer control block is allocated with additional space
+ * at the end for the text (or format string arguments). The address of
+ * that space is recorded when allocating so that it can be passed to
+ * the Message constructor. It's aligned for any type because deferred
+ * format string arguments are stored there.
+ *
+ * The allocation state is only used while the message is being created,
+ * a copy of the allocator is kept in the control block for deallocation
+ * but that must not use the allocation state. It records whether the
+ * message is in a pool slot so that heap messages never need to access
+ * the pool when they're destroyed.
+ */
+template <class T>
+class Message::Allocator {
+	template <class U>
+	friend class Allocator;
+
+public:
+	using value_type = T;
+
+	explicit Allocator(Allocation *allocation) : allocation_(allocation), pooled_(allocation->slot != nullptr) {
+	}
+
+	template <class U>
+	Allocator(const Allocator<U> &other) : allocation_(other.allocation_), pooled_(other.pooled_) {
+	}
+
+	T *allocate(size_t n) {
+		char *data;
+
+		allocation_->size = (n * sizeof(T) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+		if (allocation_->slot) {
+			data = static_cast<char *>(allocation_->slot);
+		} else {
+			data = static_cast<char *>(::operator new(allocation_->size + allocation_->storage_size));
+		}
+
+		allocation_->storage = data + allocation_->size;
+		return reinterpret_cast<T *>(data);
+	}
+
+	void deallocate(T *p, size_t) {
+		if (pooled_) {
+			MessagePool::release(p);
+		} else {
+			::operator delete(p);
+		}
+	}
+
+	template <class U, class... Args>
+	void construct(U *p, Args&&... args) {
+		::new (static_cast<void *>(p)) U(std::forward<Args>(args)..., allocation_->storage);
+	}
+
+	template <class U>
+	void destroy(U *p) {
+		p->~U();
+	}
+
+	template <class U>
+	bool operator==(const Allocator<U> &other) const {
+		return allocation_ == other.allocation_ && pooled_ == other.pooled_;
+	}
+
+	template <class U>
+	bool operator!=(const Allocator<U> &other) const {
+		return !(*this == other);
+	}
+
+private:
+	Allocation *allocation_;
+	bool pooled_;
+};
+
+MessageText::MessageText(const std::string &text)
+		: owned_(new char[text.length() + 1]), text_(owned_.get()), length_(text.length()) {
+	std::memcpy(owned_.get(), text.c_str(), text.length() + 1);
+}
+
+MessageText::MessageText(const char *text, size_t length, char *storage)
+		: text_(storage), length_(length) {
+	std::memcpy(storage, text, length);
+	storage[length] = '\0';
+}
+
+MessageText::MessageText(const MessageFormat &format, size_t spare_size, char *storage)
+		: format_(format.store(storage)), spare_(spare_size ? storage + format.size() : nullptr),
+			spare_size_(spare_size), text_(nullptr), length_(0) {
+}
+
+MessageText::MessageText(const MessageText &other)
+		: owned_(new char[other.length() + 1]), text_(owned_.get()), length_(other.length()) {
+	std::memcpy(owned_.get(), other.c_str(), other.length() + 1);
+}
+
+MessageText::~MessageText() {
+	if (format_) {
+		const char *text = text_.load(std::memory_order_relaxed);
+
+		if (text != spare_) {
+			delete[] text;
+		}
+	}
+}
+
+/*
+ * Multiple handlers could use the text at the same time, so the text is
+ * formatted independently by each of them and then only one copy is
+ * kept.
+ *
+ * The first one to finish formatting can use the spare storage in the
+ * pool slot (if the text fits) so that the heap isn't used. Any others
+ * that are formatting concurrently allocate their copy on the heap.
+ */
+const char *MessageText::format() const {
+	std::array<char, Logger::MAX_LOG_LENGTH + 1> text;
+	int ret = format_->format(text.data(), text.size());
+	size_t length = ret > 0 ? std::min((size_t)ret, text.size() - 1) : 0;
+	char *formatted;
+	const char *expected = nullptr;
+
+	if (length < spare_size_ && !spare_used_.exchange(true, std::memory_order_relaxed)) {
+		formatted = spare_;
+	} else {
+		formatted = new char[length + 1];
+	}
+
+	std::memcpy(formatted, text.data(), length);
+	formatted[length] = '\0';
+
+	length_.store(length, std::memory_order_relaxed);
+	if (text_.compare_exchange_strong(expected, formatted, std::memory_order_acq_rel, std::memory_order_acquire)) {
+		return formatted;
+	} else {
+		if (formatted != spare_) {
+			delete[] formatted;
+		}
+		return expected;
+	}
+}
+
+Message::Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, std::string &&text)
+		: uptime_ms(uptime_ms), level(level), facility(facility), name(name), text(text) {
+}
+
+Message::Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const char *text, size_t length, char *storage)
+		: uptime_ms(uptime_ms), level(level), facility(facility), name(name), text(text, length, storage) {
+}
+
+std::shared_ptr<Message> Message::create(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const char *text, size_t length) {
+	Allocation allocation{length + 1, nullptr, 0, nullptr};
+	bool drop = false;
+
+	allocation.slot = MessagePool::allocate(allocation.storage_size, drop);
+	if (drop) {
+		return nullptr;
+	}
+
+	return std::allocate_shared<Message>(Allocator<Message>{&allocation}, uptime_ms, level, facility, name, text, length);
+}
+
+Message::Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const MessageFormat &format, size_t spare_size, char *storage)
+		: uptime_ms(uptime_ms), level(level), facility(facility), name(name), text(format, spare_size, storage) {
+}
+
+std::shared_ptr<Message> Message::create(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const MessageFormat &format) {
+	Allocation allocation{format.size(), nullptr, 0, nullptr};
+	size_t spare_size = 0;
+	bool drop = false;
+
+	allocation.slot = MessagePool::allocate(allocation.storage_size, drop);
+	if (drop) {
+		return nullptr;
+	}
+
+	/*
+	 * The pool can't be reconfigured while this slot is in use, so the
+	 * rest of the slot after the arguments can be used for the text.
+	 */
+	if (allocation.slot) {
+		spare_size = MessagePool::slot_size_ - allocation_size() - allocation.storage_size;
+	}
+
+	return std::allocate_shared<Message>(Allocator<Message>{&allocation}, uptime_ms, level, facility, name, format, spare_size);
+}
+
+size_t Message::allocation_size() {
+	static const size_t size = [] {
+		Allocation allocation{1, nullptr, 0, nullptr};
+
+		std::allocate_shared<Message>(Allocator<Message>{&allocation}, 0, Level::OFF, Facility::KERN, nullptr, "", 0);
+		return allocation.size;
+	}();
+
+	return size;
+}
+
+} // namespace log
+
+} // namespace uuid
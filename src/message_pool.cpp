@@ -0,0 +1,182 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#if UUID_LOG_THREAD_SAFE
+# include <mutex>
+#endif
+
+namespace uuid {
+
+namespace log {
+
+#if UUID_LOG_THREAD_SAFE
+std::mutex MessagePool::mutex_;
+#endif
+std::unique_ptr<char[]> MessagePool::storage_;
+std::unique_ptr<std::atomic<uint32_t>[]> MessagePool::next_;
+size_t MessagePool::slot_size_ = 0;
+size_t MessagePool::text_length_ = 0;
+std::atomic<size_t> MessagePool::count_{0};
+std::atomic<size_t> MessagePool::users_{0};
+std::atomic<uint64_t> MessagePool::free_{NO_SLOT};
+MessagePool::Policy MessagePool::policy_ = MessagePool::Policy::HEAP;
+std::atomic<unsigned long> MessagePool::pool_allocations_{0};
+std::atomic<unsigned long> MessagePool::heap_allocations_{0};
+std::atomic<unsigned long> MessagePool::dropped_messages_{0};
+
+/*
+ * Slots are allocated and released without locking a mutex. The free
+ * list is a stack of slot indices, with a count of changes stored
+ * alongside the index of the first slot so that a slot that is
+ * released and allocated again between reading the first slot and
+ * replacing it can't corrupt the list.
+ *
+ * The number of users prevents the pool from being reconfigured while
+ * slots are in use or being allocated. While the pool is being
+ * configured, allocations see the CONFIGURING flag and use the heap
+ * instead of waiting.
+ */
+bool MessagePool::configure(size_t count, Policy policy, size_t text_length) {
+	/* This may allocate and release a message, so it can't be called with the mutex locked. */
+	size_t slot_size = Message::allocation_size() + text_length + 1;
+	size_t users = 0;
+
+	/* Each slot must be aligned for the next one. */
+	slot_size = (slot_size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+	if (count >= NO_SLOT) {
+		return false;
+	}
+
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	if (!users_.compare_exchange_strong(users, CONFIGURING, std::memory_order_acquire, std::memory_order_relaxed)) {
+		return false;
+	}
+
+	count_.store(0, std::memory_order_relaxed);
+	free_.store(NO_SLOT, std::memory_order_relaxed);
+	storage_.reset();
+	next_.reset();
+
+	if (count > 0) {
+		/* Slots are aligned because the storage is allocated using operator new. */
+		storage_.reset(new char[count * slot_size]);
+		next_.reset(new std::atomic<uint32_t>[count]);
+
+		for (size_t i = 0; i < count; i++) {
+			next_[i].store((i + 1 < count) ? i + 1 : NO_SLOT, std::memory_order_relaxed);
+		}
+
+		free_.store(0, std::memory_order_relaxed);
+	}
+
+	slot_size_ = slot_size;
+	text_length_ = text_length;
+	policy_ = policy;
+	count_.store(count, std::memory_order_release);
+	users_.fetch_sub(CONFIGURING, std::memory_order_release);
+	return true;
+}
+
+size_t MessagePool::count() {
+	return count_.load(std::memory_order_relaxed);
+}
+
+size_t MessagePool::available() {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	const size_t count = count_.load(std::memory_order_relaxed);
+
+	return count - std::min(users_.load(std::memory_order_relaxed), count);
+}
+
+unsigned long MessagePool::pool_allocations() {
+	return pool_allocations_.load(std::memory_order_relaxed);
+}
+
+unsigned long MessagePool::heap_allocations() {
+	return heap_allocations_.load(std::memory_order_relaxed);
+}
+
+unsigned long MessagePool::dropped_messages() {
+	return dropped_messages_.load(std::memory_order_relaxed);
+}
+
+void *MessagePool::allocate(size_t size, bool &drop) {
+	if (count_.load(std::memory_order_relaxed) == 0) {
+		return nullptr;
+	}
+
+	if (users_.fetch_add(1, std::memory_order_acquire) >= CONFIGURING
+			|| count_.load(std::memory_order_relaxed) == 0) {
+		users_.fetch_sub(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	uint64_t head = free_.load(std::memory_order_acquire);
+	uint64_t next;
+
+	do {
+		const uint32_t index = static_cast<uint32_t>(head);
+
+		if (index == NO_SLOT || size > text_length_ + 1) {
+			if (policy_ == Policy::DROP) {
+				dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+				drop = true;
+			} else {
+				heap_allocations_.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			users_.fetch_sub(1, std::memory_order_release);
+			return nullptr;
+		}
+
+		next = (((head >> 32) + 1) << 32) | next_[index].load(std::memory_order_relaxed);
+	} while (!free_.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire));
+
+	pool_allocations_.fetch_add(1, std::memory_order_relaxed);
+	return &storage_[static_cast<uint32_t>(head) * slot_size_];
+}
+
+void MessagePool::release(void *ptr) {
+	const uint32_t index = (static_cast<char *>(ptr) - storage_.get()) / slot_size_;
+	uint64_t head = free_.load(std::memory_order_relaxed);
+	uint64_t next;
+
+	do {
+		next_[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+		next = (((head >> 32) + 1) << 32) | index;
+	} while (!free_.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+
+	users_.fetch_sub(1, std::memory_order_release);
+}
+
+} // namespace log
+
+} // namespace uuid
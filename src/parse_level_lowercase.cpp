@@ -20,6 +20,7 @@
 
 #include <Arduino.h>
 
+#include <cstring>
 #include <string>
 
 namespace uuid {
@@ -27,11 +28,64 @@ namespace uuid {
 namespace log {
 
 bool parse_level_lowercase(const std::string &name, Level &level) {
-	for (auto value : levels()) {
-		if (!strcmp_P(name.c_str(), reinterpret_cast<PGM_P>(format_level_lowercase(value)))) {
-			level = value;
-			return true;
+	return parse_level_lowercase(name.c_str(), name.length(), level);
+}
+
+bool parse_level_lowercase(const char *name, Level &level) {
+	return parse_level_lowercase(name, ::strlen(name), level);
+}
+
+bool parse_level_lowercase(const char *name, size_t length, Level &level) {
+	Level value;
+
+	if (length < 3) {
+		return false;
+	}
+
+	/* Select the only possible level using the length and first character */
+	switch (length) {
+	case 3:
+		switch (name[0]) {
+		case 'o': value = Level::OFF; break;
+		case 'e': value = Level::ERR; break;
+		case 'a': value = Level::ALL; break;
+		default: return false;
+		}
+		break;
+
+	case 4:
+		switch (name[0]) {
+		case 'c': value = Level::CRIT; break;
+		case 'i': value = Level::INFO; break;
+		default: return false;
+		}
+		break;
+
+	case 5:
+		switch (name[0]) {
+		case 'e': value = Level::EMERG; break;
+		case 'a': value = Level::ALERT; break;
+		case 'd': value = Level::DEBUG; break;
+		case 't': value = Level::TRACE; break;
+		default: return false;
 		}
+		break;
+
+	case 6:
+		value = Level::NOTICE;
+		break;
+
+	case 7:
+		value = Level::WARNING;
+		break;
+
+	default:
+		return false;
+	}
+
+	if (!strncmp_P(name, reinterpret_cast<PGM_P>(format_level_lowercase(value)), length)) {
+		level = value;
+		return true;
 	}
 	return false;
 }
@@ -20,6 +20,7 @@
 
 #include <Arduino.h>
 
+#include <cstring>
 #include <string>
 
 namespace uuid {
@@ -27,11 +28,64 @@ namespace uuid {
 namespace log {
 
 bool parse_level_uppercase(const std::string &name, Level &level) {
-	for (auto value : levels()) {
-		if (!strcmp_P(name.c_str(), reinterpret_cast<PGM_P>(format_level_uppercase(value)))) {
-			level = value;
-			return true;
+	return parse_level_uppercase(name.c_str(), name.length(), level);
+}
+
+bool parse_level_uppercase(const char *name, Level &level) {
+	return parse_level_uppercase(name, ::strlen(name), level);
+}
+
+bool parse_level_uppercase(const char *name, size_t length, Level &level) {
+	Level value;
+
+	if (length < 3) {
+		return false;
+	}
+
+	/* Select the only possible level using the length and first character */
+	switch (length) {
+	case 3:
+		switch (name[0]) {
+		case 'O': value = Level::OFF; break;
+		case 'E': value = Level::ERR; break;
+		case 'A': value = Level::ALL; break;
+		default: return false;
+		}
+		break;
+
+	case 4:
+		switch (name[0]) {
+		case 'C': value = Level::CRIT; break;
+		case 'I': value = Level::INFO; break;
+		default: return false;
+		}
+		break;
+
+	case 5:
+		switch (name[0]) {
+		case 'E': value = Level::EMERG; break;
+		case 'A': value = Level::ALERT; break;
+		case 'D': value = Level::DEBUG; break;
+		case 'T': value = Level::TRACE; break;
+		default: return false;
 		}
+		break;
+
+	case 6:
+		value = Level::NOTICE;
+		break;
+
+	case 7:
+		value = Level::WARNING;
+		break;
+
+	default:
+		return false;
+	}
+
+	if (!strncmp_P(name, reinterpret_cast<PGM_P>(format_level_uppercase(value)), length)) {
+		level = value;
+		return true;
 	}
 	return false;
 }
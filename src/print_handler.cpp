@@ -20,16 +20,138 @@
 
 #include <Arduino.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #if UUID_LOG_THREAD_SAFE
 # include <mutex>
 #endif
+#include <string>
+
+#include <uuid/common.h>
 
 namespace uuid {
 
 namespace log {
 
-PrintHandler::PrintHandler(::Print &print) : print_(print) {
+//! @cond false
+/*
+ * Bounded multi-producer multi-consumer queue (Dmitry Vyukov) with a
+ * capacity that is a power of 2. Each cell has a sequence number that
+ * indicates whether it is ready to be written or read at a position.
+ *
+ * There is only one real consumer (loop()) but producers also remove the
+ * oldest message when the queue is full.
+ */
+class PrintHandler::LockFreeQueue {
+public:
+	explicit LockFreeQueue(size_t count) {
+		const size_t capacity = LockFreeQueue::capacity(count);
+
+		cells_ = std::unique_ptr<Cell[]>{new Cell[capacity]};
+		mask_ = capacity - 1;
+
+		for (size_t i = 0; i < capacity; i++) {
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	bool push(std::shared_ptr<Message> &message) {
+		size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		while (true) {
+			cell = &cells_[pos & mask_];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+			if (diff == 0) {
+				if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->message = std::move(message);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(std::shared_ptr<Message> &message) {
+		size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		while (true) {
+			cell = &cells_[pos & mask_];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+			if (diff == 0) {
+				if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = dequeue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		message = std::move(cell->message);
+		cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+		return true;
+	}
+
+	static size_t capacity(size_t count) {
+		size_t capacity = 1;
+
+		while (capacity < count) {
+			capacity <<= 1;
+		}
+
+		return capacity;
+	}
+
+	void push_discard_oldest(std::shared_ptr<Message> &message) {
+		while (!push(message)) {
+			std::shared_ptr<Message> discard;
+
+			pop(discard);
+		}
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		std::shared_ptr<Message> message;
+	};
+
+	std::unique_ptr<Cell[]> cells_;
+	size_t mask_;
+	std::atomic<size_t> enqueue_pos_{0};
+	std::atomic<size_t> dequeue_pos_{0};
+};
+//! @endcond
+
+PrintHandler::PrintHandler(::Print &print) : print_(print), lock_free_(false) {
+}
+
+PrintHandler::PrintHandler(::Print &print, bool lock_free) : print_(print), lock_free_(lock_free) {
+	if (lock_free_) {
+		maximum_log_messages_ = LockFreeQueue::capacity(maximum_log_messages_);
+		lock_free_queue_ = std::unique_ptr<LockFreeQueue>{new LockFreeQueue{maximum_log_messages_}};
+	}
+}
+
+PrintHandler::~PrintHandler() {
+	Logger::unregister_handler(this);
 }
 
 size_t PrintHandler::maximum_log_messages() const {
@@ -45,59 +167,271 @@ void PrintHandler::maximum_log_messages(size_t count) {
 	std::lock_guard<std::mutex> lock{mutex_};
 #endif
 
-	maximum_log_messages_ = std::max((size_t)1, count);
+	count = std::max((size_t)1, count);
 
-	while (log_messages_.size() > maximum_log_messages_) {
-		log_messages_.pop_front();
+	if (lock_free_) {
+		count = LockFreeQueue::capacity(count);
 	}
+
+	if (count == maximum_log_messages_) {
+		return;
+	}
+
+	const size_t previous_maximum = maximum_log_messages_;
+
+	maximum_log_messages_ = count;
+
+	if (lock_free_) {
+		std::unique_ptr<LockFreeQueue> queue{new LockFreeQueue{maximum_log_messages_}};
+		std::shared_ptr<Message> message;
+
+		resizing_ = true;
+		while (producers_ != 0) {
+			::yield();
+		}
+
+		while (lock_free_queue_->pop(message)) {
+			queue->push_discard_oldest(message);
+		}
+
+		lock_free_queue_ = std::move(queue);
+		resizing_ = false;
+	} else if (log_messages_) {
+		std::unique_ptr<std::shared_ptr<Message>[]> messages{new std::shared_ptr<Message>[maximum_log_messages_]};
+		const size_t discard = log_messages_count_ - std::min(log_messages_count_, maximum_log_messages_);
+
+		log_messages_count_ -= discard;
+
+		for (size_t i = 0; i < log_messages_count_; i++) {
+			messages[i] = std::move(log_messages_[(log_messages_head_ + discard + i) % previous_maximum]);
+		}
+
+		log_messages_ = std::move(messages);
+		log_messages_head_ = 0;
+	}
+}
+
+size_t PrintHandler::maximum_write_size() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	return maximum_write_size_;
+}
+
+void PrintHandler::maximum_write_size(size_t size) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	maximum_write_size_ = size;
+}
+
+bool PrintHandler::suppress_duplicates() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	return suppress_duplicates_;
+}
+
+void PrintHandler::suppress_duplicates(bool enabled) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	if (lock_free_) {
+		return;
+	}
+
+	if (!enabled) {
+		enqueue_repeated();
+		last_message_.reset();
+	}
+
+	suppress_duplicates_ = enabled;
 }
 
 void PrintHandler::loop(size_t count) {
 #if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> output_lock{output_mutex_};
 	std::unique_lock<std::mutex> lock{mutex_};
 #endif
+	const size_t maximum_write_size = maximum_write_size_;
+	std::shared_ptr<Message> message;
 
-	count = std::max((size_t)1, count);
+	if (repeated_messages_ > 0 && uuid::get_uptime_ms() - repeated_start_ms_ >= REPEATED_MESSAGES_INTERVAL_MS) {
+		enqueue_repeated();
+	}
 
-	while (!log_messages_.empty()) {
-		auto message = log_messages_.front();
+	count = std::max((size_t)1, count);
 
-		log_messages_.pop_front();
+	while (next_message(message)) {
 #if UUID_LOG_THREAD_SAFE
 		lock.unlock();
 #endif
+		const size_t length = output_.size();
+
+		append(*message);
+		message.reset();
+
+		if (length > 0 && output_.size() > maximum_write_size) {
+			/* Write the previous messages before exceeding the maximum size */
+			write(length);
+			::yield();
+		}
 
-		print_.print(uuid::log::format_timestamp_ms(message->uptime_ms, 3).c_str());
-		print_.print(' ');
-		print_.print(uuid::log::format_level_char(message->level));
-		print_.print(F(" ["));
-		print_.print(message->name);
-		print_.print(F("] "));
-		print_.println(message->text.c_str());
+		if (output_.size() >= maximum_write_size) {
+			write(output_.size());
+		}
 
 		count--;
 		if (count == 0) {
 			break;
 		}
 
-		::yield();
+		if (output_.empty()) {
+			::yield();
+		}
 
 #if UUID_LOG_THREAD_SAFE
 		lock.lock();
 #endif
 	}
+
+#if UUID_LOG_THREAD_SAFE
+	if (lock.owns_lock()) {
+		lock.unlock();
+	}
+#endif
+
+	if (!output_.empty()) {
+		write(output_.size());
+	}
+}
+
+/* Mutex already locked by caller. */
+bool PrintHandler::next_message(std::shared_ptr<Message> &message) {
+	if (lock_free_) {
+		return lock_free_queue_->pop(message);
+	}
+
+	if (log_messages_count_ == 0) {
+		return false;
+	}
+
+	message = std::move(log_messages_[log_messages_head_]);
+	log_messages_head_ = (log_messages_head_ + 1) % maximum_log_messages_;
+	log_messages_count_--;
+	return true;
+}
+
+void PrintHandler::append(const Message &message) {
+	const size_t name_length = ::strlen_P(reinterpret_cast<PGM_P>(message.name));
+	std::array<char,MAX_TIMESTAMP_MS_LENGTH + 1> timestamp;
+	size_t pos;
+
+	output_.append(timestamp.data(), timestamp_.format(timestamp.data(), timestamp.size(), message.uptime_ms));
+	output_ += ' ';
+	output_ += uuid::log::format_level_char(message.level);
+	output_ += " [";
+	pos = output_.size();
+	output_.resize(pos + name_length);
+	::memcpy_P(&output_[pos], reinterpret_cast<PGM_P>(message.name), name_length);
+	output_ += "] ";
+	output_.append(message.text.c_str(), message.text.length());
+	output_ += "\r\n";
+}
+
+void PrintHandler::write(size_t length) {
+	print_.write(reinterpret_cast<const uint8_t *>(output_.data()), length);
+	output_.erase(0, length);
 }
 
 void PrintHandler::operator<<(std::shared_ptr<Message> message) {
+	if (lock_free_) {
+		/* The queue can only be used while it's not being replaced. */
+		producers_++;
+
+		while (resizing_) {
+			producers_--;
+			while (resizing_) {
+				::yield();
+			}
+			producers_++;
+		}
+
+		lock_free_queue_->push_discard_oldest(message);
+		producers_--;
+		return;
+	}
+
 #if UUID_LOG_THREAD_SAFE
 	std::lock_guard<std::mutex> lock{mutex_};
 #endif
 
-	if (log_messages_.size() >= maximum_log_messages_) {
-		log_messages_.pop_front();
+	if (suppress_duplicates_) {
+		if (last_message_ && duplicate(*last_message_, *message)) {
+			if (repeated_messages_ == 0) {
+				repeated_start_ms_ = message->uptime_ms;
+			}
+
+			repeated_messages_++;
+			repeated_last_ms_ = message->uptime_ms;
+			return;
+		}
+
+		enqueue_repeated();
+		last_message_ = message;
 	}
 
-	log_messages_.emplace_back(std::move(message));
+	enqueue(std::move(message));
+}
+
+/* Mutex already locked by caller. */
+void PrintHandler::enqueue(std::shared_ptr<Message> message) {
+	if (!log_messages_) {
+		log_messages_ = std::unique_ptr<std::shared_ptr<Message>[]>{new std::shared_ptr<Message>[maximum_log_messages_]};
+	}
+
+	if (log_messages_count_ >= maximum_log_messages_) {
+		/* Replace the oldest message */
+		log_messages_[log_messages_head_] = std::move(message);
+		log_messages_head_ = (log_messages_head_ + 1) % maximum_log_messages_;
+	} else {
+		log_messages_[(log_messages_head_ + log_messages_count_) % maximum_log_messages_] = std::move(message);
+		log_messages_count_++;
+	}
+}
+
+/* Mutex already locked by caller. */
+void PrintHandler::enqueue_repeated() {
+	if (repeated_messages_ == 0) {
+		return;
+	}
+
+	std::array<char, 48> text;
+	int ret = snprintf_P(text.data(), text.size(), PSTR("last message repeated %lu times"), repeated_messages_);
+
+	repeated_messages_ = 0;
+
+	if (ret > 0) {
+		auto message = Message::create(repeated_last_ms_, last_message_->level,
+			last_message_->facility, last_message_->name, text.data(),
+			std::min((size_t)ret, text.size() - 1));
+
+		if (message) {
+			enqueue(std::move(message));
+		}
+	}
+}
+
+bool PrintHandler::duplicate(const Message &message1, const Message &message2) {
+	return message1.level == message2.level
+		&& message1.facility == message2.facility
+		&& message1.name == message2.name
+		&& message1.text.length() == message2.text.length()
+		&& !std::memcmp(message1.text.c_str(), message2.text.c_str(), message1.text.length());
 }
 
 } // namespace log
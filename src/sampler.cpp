@@ -0,0 +1,49 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include <uuid/common.h>
+
+namespace uuid {
+
+namespace log {
+
+bool Sampler::interval(uint32_t interval_ms) {
+	const uint32_t now_ms = uuid::get_uptime_ms();
+	uint32_t last_ms = last_ms_.load(std::memory_order_relaxed);
+
+	if (count_.load(std::memory_order_relaxed) != 0 && (uint32_t)(now_ms - last_ms) < interval_ms) {
+		return false;
+	}
+
+	/* Only one concurrent caller can log the message */
+	if (!last_ms_.compare_exchange_strong(last_ms, now_ms, std::memory_order_relaxed)) {
+		return false;
+	}
+
+	count_.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+} // namespace log
+
+} // namespace uuid
@@ -0,0 +1,497 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <uuid/log.h>
+
+#if UUID_LOG_SYSLOG_AVAILABLE
+
+#include <Arduino.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#if UUID_LOG_THREAD_SAFE
+# include <mutex>
+#endif
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <uuid/common.h>
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+namespace uuid {
+
+namespace log {
+
+//! @cond false
+/* The system clock is assumed to be set if it's after 2020-01-01 */
+static constexpr int64_t CLOCK_VALID_S = 1577836800;
+static constexpr size_t MAX_NAME_LENGTH = 32;
+
+static const char months[] PROGMEM = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+static void append_number(std::string &output, uint64_t value, size_t width = 1) {
+	char digits[20];
+	size_t length = 0;
+
+	do {
+		digits[length++] = '0' + (value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	while (length < width) {
+		digits[length++] = '0';
+	}
+
+	while (length > 0) {
+		output.push_back(digits[--length]);
+	}
+}
+
+static void append_field(std::string &output, const std::string &value) {
+	if (value.empty()) {
+		output.push_back('-');
+	} else {
+		output.append(value);
+	}
+}
+
+/*
+ * Append a logger name (flash string) as an RFC 5424 MSGID (printable
+ * US-ASCII) or an RFC 3164 TAG (alphanumeric).
+ */
+static void append_name(std::string &output, const __FlashStringHelper *name, bool alphanumeric) {
+	PGM_P text = reinterpret_cast<PGM_P>(name);
+	size_t length = 0;
+
+	for (; length < MAX_NAME_LENGTH; length++) {
+		char c = pgm_read_byte(&text[length]);
+
+		if (c == '\0') {
+			break;
+		} else if (alphanumeric
+				? !((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+				: (c < 33 || c > 126)) {
+			c = '_';
+		}
+
+		output.push_back(c);
+	}
+
+	if (length == 0) {
+		output.push_back('-');
+	}
+}
+//! @endcond
+
+SyslogHandler::SyslogHandler(Format format) : format_(format) {
+}
+
+SyslogHandler::~SyslogHandler() {
+	Logger::unregister_handler(this);
+	disconnect();
+}
+
+bool SyslogHandler::destination(const char *host, uint16_t port, Transport transport) {
+	struct addrinfo hints{};
+	struct addrinfo *result = nullptr;
+	std::string service;
+
+	hints.ai_socktype = transport == Transport::TCP ? SOCK_STREAM : SOCK_DGRAM;
+	append_number(service, port);
+
+	int ret = ::getaddrinfo(host, service.c_str(), &hints, &result);
+
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> output_lock{output_mutex_};
+#endif
+
+	disconnect();
+
+	{
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+		address_.clear();
+		log_messages_.clear();
+
+		if (ret == 0 && result) {
+			address_.assign(reinterpret_cast<const char *>(result->ai_addr), result->ai_addrlen);
+			transport_ = transport;
+		}
+	}
+
+	if (ret != 0 || !result) {
+		return false;
+	}
+
+	::freeaddrinfo(result);
+
+	/* Connect without the queue locked so that messages can still be logged */
+	return connect();
+}
+
+void SyslogHandler::close() {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> output_lock{output_mutex_};
+#endif
+
+	disconnect();
+
+	{
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+		address_.clear();
+		log_messages_.clear();
+	}
+}
+
+std::string SyslogHandler::hostname() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	return hostname_;
+}
+
+void SyslogHandler::hostname(std::string name) {
+	/* Both mutexes are locked for changes so that loop() only needs the output mutex */
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> output_lock{output_mutex_};
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	hostname_ = std::move(name);
+}
+
+std::string SyslogHandler::app_name() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	return app_name_;
+}
+
+void SyslogHandler::app_name(std::string name) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> output_lock{output_mutex_};
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	app_name_ = std::move(name);
+}
+
+size_t SyslogHandler::maximum_log_messages() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	return maximum_log_messages_;
+}
+
+void SyslogHandler::maximum_log_messages(size_t count) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	maximum_log_messages_ = std::max((size_t)1, count);
+}
+
+unsigned long SyslogHandler::dropped_messages() const {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+	return dropped_messages_;
+}
+
+/* Output mutex already locked by caller. */
+bool SyslogHandler::connect() {
+	struct sockaddr_storage address;
+
+	connect_ms_ = uuid::get_uptime_ms();
+
+	if (address_.empty() || address_.size() > sizeof(address)) {
+		return false;
+	}
+
+	::memcpy(&address, address_.data(), address_.size());
+
+	fd_ = ::socket(address.ss_family, transport_ == Transport::TCP ? SOCK_STREAM : SOCK_DGRAM, 0);
+	if (fd_ < 0) {
+		return false;
+	}
+
+	/* Connect without blocking so that the time taken can be limited */
+	int flags = ::fcntl(fd_, F_GETFL, 0);
+
+	if (flags < 0 || ::fcntl(fd_, F_SETFL, flags | O_NONBLOCK) < 0) {
+		disconnect();
+		return false;
+	}
+
+	if (::connect(fd_, reinterpret_cast<const struct sockaddr *>(&address), address_.size())) {
+		struct pollfd pfd{};
+		int error = 0;
+		socklen_t length = sizeof(error);
+
+		pfd.fd = fd_;
+		pfd.events = POLLOUT;
+
+		if (errno != EINPROGRESS
+				|| ::poll(&pfd, 1, CONNECT_TIMEOUT_MS) != 1
+				|| ::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length)
+				|| error != 0) {
+			disconnect();
+			return false;
+		}
+	}
+
+	if (::fcntl(fd_, F_SETFL, flags) < 0) {
+		disconnect();
+		return false;
+	}
+
+	return true;
+}
+
+/* Output mutex already locked by caller. */
+void SyslogHandler::disconnect() {
+	if (fd_ >= 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+void SyslogHandler::loop() {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> output_lock{output_mutex_};
+#endif
+
+	{
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+		/* Swap queues so that both keep their capacity */
+		log_messages_.swap(sending_);
+
+		if (sending_.empty()) {
+			return;
+		}
+	}
+
+	/* Reconnect without the queue locked so that messages can still be logged */
+	if (fd_ < 0 && (uuid::get_uptime_ms() - connect_ms_ < RECONNECT_INTERVAL_MS || !connect())) {
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+		dropped_messages_ += sending_.size();
+		sending_.clear();
+		return;
+	}
+
+	const uint64_t now_ms = uuid::get_uptime_ms();
+	const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	const int64_t now_s = now / 1000 >= CLOCK_VALID_S ? now / 1000 : 0;
+	unsigned long dropped = 0;
+	size_t batch = 0;
+
+	output_.clear();
+
+	for (auto &message : sending_) {
+		append(*message, now_ms, now_s, now % 1000);
+		batch++;
+
+		if (transport_ != Transport::TCP || output_.size() >= MAX_WRITE_SIZE) {
+			if (!send()) {
+				dropped += batch;
+			}
+
+			output_.clear();
+			batch = 0;
+		}
+	}
+
+	if (batch > 0 && !send()) {
+		dropped += batch;
+	}
+
+	sending_.clear();
+
+	if (dropped) {
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+		dropped_messages_ += dropped;
+	}
+}
+
+/* Output mutex already locked by caller. */
+void SyslogHandler::append(const Message &message, uint64_t now_ms, int64_t now_s, unsigned int now_ms_part) {
+	const size_t start = output_.size();
+	const unsigned int severity = message.level > Level::DEBUG ? Level::DEBUG : message.level;
+	struct tm tm{};
+	bool timestamp = false;
+	unsigned int milliseconds = 0;
+
+	if (now_s != 0) {
+		/* Messages have an uptime, so calculate the time they were logged */
+		int64_t time_ms = now_s * 1000 + now_ms_part - (int64_t)(now_ms - message.uptime_ms);
+		time_t time_s = time_ms / 1000;
+
+		milliseconds = time_ms % 1000;
+		timestamp = format_ == Format::RFC5424
+			? ::gmtime_r(&time_s, &tm) != nullptr
+			: ::localtime_r(&time_s, &tm) != nullptr;
+	}
+
+	output_.push_back('<');
+	append_number(output_, message.facility * 8 + severity);
+	output_.push_back('>');
+
+	if (format_ == Format::RFC5424) {
+		/* <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG */
+		output_.append("1 ", 2);
+
+		if (timestamp) {
+			append_number(output_, tm.tm_year + 1900, 4);
+			output_.push_back('-');
+			append_number(output_, tm.tm_mon + 1, 2);
+			output_.push_back('-');
+			append_number(output_, tm.tm_mday, 2);
+			output_.push_back('T');
+			append_number(output_, tm.tm_hour, 2);
+			output_.push_back(':');
+			append_number(output_, tm.tm_min, 2);
+			output_.push_back(':');
+			append_number(output_, tm.tm_sec, 2);
+			output_.push_back('.');
+			append_number(output_, milliseconds, 3);
+			output_.push_back('Z');
+		} else {
+			output_.push_back('-');
+		}
+
+		output_.push_back(' ');
+		append_field(output_, hostname_);
+		output_.push_back(' ');
+		append_field(output_, app_name_);
+		output_.append(" - ", 3);
+		append_name(output_, message.name, false);
+		output_.append(" - ", 3);
+	} else {
+		/* <PRI>Mmm dd hh:mm:ss HOSTNAME TAG: MSG */
+		if (timestamp) {
+			const size_t pos = output_.size();
+
+			output_.resize(pos + 3);
+			::memcpy_P(&output_[pos], &months[tm.tm_mon * 3], 3);
+			output_.push_back(' ');
+			if (tm.tm_mday < 10) {
+				output_.push_back(' ');
+			}
+			append_number(output_, tm.tm_mday);
+			output_.push_back(' ');
+			append_number(output_, tm.tm_hour, 2);
+			output_.push_back(':');
+			append_number(output_, tm.tm_min, 2);
+			output_.push_back(':');
+			append_number(output_, tm.tm_sec, 2);
+			output_.push_back(' ');
+			append_field(output_, hostname_);
+			output_.push_back(' ');
+		}
+
+		append_name(output_, message.name, true);
+		output_.append(": ", 2);
+	}
+
+	output_.append(message.text.c_str(), message.text.length());
+
+	if (output_.size() - start > MAX_MESSAGE_SIZE) {
+		output_.resize(start + MAX_MESSAGE_SIZE);
+	}
+
+	if (transport_ == Transport::TCP) {
+		/* Octet counting: MSG-LEN SP SYSLOG-MSG */
+		std::string length;
+
+		append_number(length, output_.size() - start);
+		length.push_back(' ');
+		output_.insert(start, length);
+	}
+}
+
+/* Output mutex already locked by caller. */
+bool SyslogHandler::send() {
+	size_t pos = 0;
+
+	if (fd_ < 0) {
+		return false;
+	}
+
+	while (pos < output_.size()) {
+		ssize_t ret = ::send(fd_, &output_[pos], output_.size() - pos, MSG_NOSIGNAL);
+
+		if (ret < 0) {
+			if (transport_ == Transport::TCP) {
+				disconnect();
+			}
+			return false;
+		}
+
+		pos += ret;
+	}
+
+	return true;
+}
+
+void SyslogHandler::operator<<(std::shared_ptr<Message> message) {
+#if UUID_LOG_THREAD_SAFE
+	std::lock_guard<std::mutex> lock{mutex_};
+#endif
+
+	if (address_.empty()) {
+		return;
+	}
+
+	if (log_messages_.size() >= maximum_log_messages_) {
+		dropped_messages_++;
+		return;
+	}
+
+	log_messages_.push_back(std::move(message));
+}
+
+} // namespace log
+
+} // namespace uuid
+
+#endif
@@ -22,13 +22,19 @@
 #include <Arduino.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdarg>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <list>
-#include <map>
 #include <memory>
+#include <new>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <uuid/common.h>
@@ -48,7 +54,26 @@
 #endif
 
 #if UUID_LOG_THREAD_SAFE
+# include <chrono>
+# include <condition_variable>
 # include <mutex>
+# include <thread>
+#endif
+
+#if defined(DOXYGEN) || defined(__linux__)
+# define UUID_LOG_MAPPED_RING_AVAILABLE 1
+#else
+# define UUID_LOG_MAPPED_RING_AVAILABLE 0
+#endif
+
+#if defined(DOXYGEN) || defined(__linux__) || defined(ESP_PLATFORM)
+# define UUID_LOG_SYSLOG_AVAILABLE 1
+#else
+# define UUID_LOG_SYSLOG_AVAILABLE 0
+#endif
+
+#ifndef UUID_LOG_MIN_LEVEL
+# define UUID_LOG_MIN_LEVEL ALL
 #endif
 
 namespace uuid {
@@ -95,6 +120,19 @@ enum Level : int8_t {
 	ALL, /*!< Meta level representing all log messages. @since 1.0.0 */
 };
 
+/**
+ * Minimum log level that is compiled in.
+ *
+ * Set using the UUID_LOG_MIN_LEVEL macro to the name of a level (e.g.
+ * `-DUUID_LOG_MIN_LEVEL=INFO`). Messages logged at a lower level will
+ * never be enabled, and messages logged with the UUID_LOG_EMERG() to
+ * UUID_LOG_TRACE() macros at a lower level will be removed at compile
+ * time.
+ *
+ * @since 4.0.0
+ */
+static constexpr Level min_level = static_cast<Level>(UUID_LOG_MIN_LEVEL);
+
 /**
  * Facility type of the process logging a message.
  *
@@ -127,6 +165,36 @@ enum Facility : uint8_t {
 	LOCAL7, /*!< Locally used facility 7. @since 1.0.0 */
 };
 
+/**
+ * Number of logging facilities, from uuid::log::Facility::KERN to
+ * uuid::log::Facility::LOCAL7.
+ *
+ * @since 4.0.0
+ */
+static constexpr size_t NUM_FACILITIES = (int)Facility::LOCAL7 - (int)Facility::KERN + 1;
+
+/**
+ * Mask of all logging facilities, for use with
+ * uuid::log::Logger::register_handler().
+ *
+ * @since 4.0.0
+ */
+static constexpr uint32_t ALL_FACILITIES = (UINT32_C(1) << NUM_FACILITIES) - 1;
+
+/**
+ * Get the mask for a logging facility, for use with
+ * uuid::log::Logger::register_handler().
+ *
+ * Masks for multiple facilities can be combined using bitwise or.
+ *
+ * @param[in] facility Logging facility.
+ * @return Mask containing only the specified facility.
+ * @since 4.0.0
+ */
+constexpr uint32_t facility_mask(Facility facility) {
+	return facility < NUM_FACILITIES ? (UINT32_C(1) << facility) : 0;
+}
+
 /**
  * Format a system uptime timestamp as a string.
  *
@@ -139,6 +207,92 @@ enum Facility : uint8_t {
  */
 std::string format_timestamp_ms(uint64_t timestamp_ms, unsigned int days_width = 1);
 
+/**
+ * Maximum length of a formatted system uptime timestamp, not including
+ * the null terminator.
+ *
+ * @since 4.0.0
+ */
+static constexpr size_t MAX_TIMESTAMP_MS_LENGTH = 12 + 1 /* days */ + 2 + 1 /* hours */ + 2 + 1 /* minutes */ + 2 + 1 /* seconds */ + 3 /* milliseconds */;
+
+/**
+ * Format a system uptime timestamp into a buffer.
+ *
+ * Using the format "d+HH:mm:ss.SSS" with leading zeros for the days.
+ * The output is truncated if the buffer is too small and is always
+ * null terminated (unless the size is 0).
+ *
+ * @param[out] buffer Buffer for the formatted system uptime.
+ * @param[in] size Size of the buffer, including space for the null
+ *                 terminator (MAX_TIMESTAMP_MS_LENGTH + 1 will always
+ *                 be enough).
+ * @param[in] timestamp_ms System uptime in milliseconds, see uuid::get_uptime_ms().
+ * @param[in] days_width Leading zeros for the days part of the output.
+ * @return Length of the formatted system uptime in the buffer, not
+ *         including the null terminator.
+ * @since 4.0.0
+ */
+size_t format_timestamp_ms(char *buffer, size_t size, uint64_t timestamp_ms, unsigned int days_width = 1);
+
+/**
+ * Formatter for system uptime timestamps that are mostly in
+ * chronological order.
+ *
+ * The days, hours and minutes are reused from the previous timestamp
+ * when the next timestamp is in the same minute.
+ *
+ * @since 4.0.0
+ */
+class TimestampFormatter {
+public:
+	/**
+	 * Create a new timestamp formatter.
+	 *
+	 * @param[in] days_width Leading zeros for the days part of the
+	 *                       output.
+	 * @since 4.0.0
+	 */
+	explicit TimestampFormatter(unsigned int days_width = 1);
+
+	/**
+	 * Format a system uptime timestamp into a buffer.
+	 *
+	 * Using the same format as format_timestamp_ms().
+	 *
+	 * @param[out] buffer Buffer for the formatted system uptime.
+	 * @param[in] size Size of the buffer, including space for the null
+	 *                 terminator.
+	 * @param[in] timestamp_ms System uptime in milliseconds, see uuid::get_uptime_ms().
+	 * @return Length of the formatted system uptime in the buffer, not
+	 *         including the null terminator.
+	 * @since 4.0.0
+	 */
+	size_t format(char *buffer, size_t size, uint64_t timestamp_ms);
+
+private:
+	unsigned int days_width_; /*!< Leading zeros for the days part of the output. @since 4.0.0 */
+	uint64_t minute_start_ms_ = 0; /*!< Start of the minute for the cached days, hours and minutes. @since 4.0.0 */
+	size_t prefix_length_ = 0; /*!< Length of the cached days, hours and minutes (0 if there is nothing cached). @since 4.0.0 */
+	std::array<char,MAX_TIMESTAMP_MS_LENGTH> text_; /*!< Formatted timestamp, starting with the cached days, hours and minutes. @since 4.0.0 */
+};
+
+/**
+ * Number of log levels, from uuid::log::Level::OFF to
+ * uuid::log::Level::ALL.
+ *
+ * @since 4.0.0
+ */
+static constexpr size_t NUM_LEVELS = (int)Level::ALL - (int)Level::OFF + 1;
+
+/**
+ * Get all log levels without allocating memory.
+ *
+ * @return A static array of all log levels in priority order from
+ *         uuid::log::Level::OFF to uuid::log::Level::ALL.
+ * @since 4.0.0
+ */
+const std::array<Level,NUM_LEVELS> &all_levels();
+
 /**
  * Get all log levels.
  *
@@ -169,6 +323,17 @@ char format_level_char(Level level);
  */
 const __FlashStringHelper *format_level_uppercase(Level level);
 
+/**
+ * Get the names of all log levels as uppercase strings without
+ * allocating memory.
+ *
+ * @return A static array of the names of all log levels in priority
+ *         order from uuid::log::Level::OFF to uuid::log::Level::ALL
+ *         as uppercase strings (flash strings).
+ * @since 4.0.0
+ */
+const std::array<const __FlashStringHelper *,NUM_LEVELS> &level_names_uppercase();
+
 /**
  * Get all log levels as uppercase strings.
  *
@@ -189,6 +354,30 @@ std::vector<std::string> levels_uppercase();
  */
 bool parse_level_uppercase(const std::string &name, Level &level);
 
+/**
+ * Parse an uppercase string to a log level.
+ *
+ * @param[in] name Uppercase name of the log level.
+ * @param[out] level Log level.
+ * @return True if the named level is valid, otherwise false.
+ * @since 4.0.0
+ */
+bool parse_level_uppercase(const char *name, Level &level);
+
+/**
+ * Parse an uppercase string to a log level.
+ *
+ * Does not allocate any memory.
+ *
+ * @param[in] name Uppercase name of the log level (does not need to be
+ *                 null terminated).
+ * @param[in] length Length of the name.
+ * @param[out] level Log level.
+ * @return True if the named level is valid, otherwise false.
+ * @since 4.0.0
+ */
+bool parse_level_uppercase(const char *name, size_t length, Level &level);
+
 /**
  * Format a log level as a lowercase string.
  *
@@ -198,6 +387,17 @@ bool parse_level_uppercase(const std::string &name, Level &level);
  */
 const __FlashStringHelper *format_level_lowercase(Level level);
 
+/**
+ * Get the names of all log levels as lowercase strings without
+ * allocating memory.
+ *
+ * @return A static array of the names of all log levels in priority
+ *         order from uuid::log::Level::OFF to uuid::log::Level::ALL
+ *         as lowercase strings (flash strings).
+ * @since 4.0.0
+ */
+const std::array<const __FlashStringHelper *,NUM_LEVELS> &level_names_lowercase();
+
 /**
  * Get all log levels as lowercase strings.
  *
@@ -219,637 +419,2821 @@ std::vector<std::string> levels_lowercase();
 bool parse_level_lowercase(const std::string &name, Level &level);
 
 /**
- * Log message text with timestamp and logger attributes.
+ * Parse a lowercase string to a log level.
  *
- * These will be created when a message is logged and then passed to
- * all registered handlers.
+ * @param[in] name Lowercase name of the log level.
+ * @param[out] level Log level.
+ * @return True if the named level is valid, otherwise false.
+ * @since 4.0.0
+ */
+bool parse_level_lowercase(const char *name, Level &level);
+
+/**
+ * Parse a lowercase string to a log level.
  *
- * @since 1.0.0
+ * Does not allocate any memory.
+ *
+ * @param[in] name Lowercase name of the log level (does not need to be
+ *                 null terminated).
+ * @param[in] length Length of the name.
+ * @param[out] level Log level.
+ * @return True if the named level is valid, otherwise false.
+ * @since 4.0.0
  */
-struct Message {
-	/**
-	 * Create a new log message (not directly useful).
-	 *
-	 * @param[in] uptime_ms System uptime, see uuid::get_uptime_ms().
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] name Logger name (flash string).
-	 * @param[in] text Log message text.
-	 * @since 1.0.0
-	 */
-	Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const std::string &&text);
-	~Message() = default;
+bool parse_level_lowercase(const char *name, size_t length, Level &level);
 
-	/**
-	 * System uptime at the time the message was logged.
-	 *
-	 * @see uuid::get_uptime_ms()
-	 * @since 1.0.0
-	 */
-	const uint64_t uptime_ms;
+struct Message;
 
+/**
+ * Format string and arguments for a log message that has not been
+ * formatted yet.
+ *
+ * @since 4.0.0
+ */
+class MessageFormat {
+public:
 	/**
-	 * Severity level of the message.
+	 * Get the size of the storage required for the format string
+	 * arguments.
 	 *
-	 * @since 1.0.0
+	 * @return Size of the storage required in bytes.
+	 * @since 4.0.0
 	 */
-	const Level level;
+	virtual size_t size() const = 0;
 
 	/**
-	 * Facility type of the process that logged the message.
+	 * Copy the format string arguments to storage owned by a
+	 * message.
 	 *
-	 * @since 1.0.0
-	 */
-	const Facility facility;
-
-	/**
-	 * Name of the logger used (flash string).
+	 * Strings passed as arguments are copied so that they remain
+	 * valid until the message is formatted.
 	 *
-	 * @since 1.0.0
+	 * @param[in] storage Storage of at least size() bytes, aligned
+	 *                    to alignof(std::max_align_t).
+	 * @return The stored copy of the format string arguments.
+	 * @since 4.0.0
 	 */
-	const __FlashStringHelper *name;
+	virtual const MessageFormat *store(void *storage) const = 0;
 
 	/**
-	 * Formatted log message text.
-	 *
-	 * Does not include any of the other message attributes, those must
-	 * be added by the handler when outputting messages.
+	 * Format the message.
 	 *
-	 * @since 1.0.0
+	 * @param[out] buffer Destination for the formatted text.
+	 * @param[in] size Size of the destination buffer.
+	 * @return The return value of snprintf().
+	 * @since 4.0.0
 	 */
-	const std::string text;
+	virtual int format(char *buffer, size_t size) const = 0;
+
+protected:
+	MessageFormat() = default;
+	MessageFormat(const MessageFormat&) = default;
+	~MessageFormat() = default;
 };
 
-class Logger;
+//! @cond false
+template <typename T>
+struct DeferredArgument {
+	static_assert(std::is_scalar<T>::value, "Deferred format arguments must be scalar types");
+	static_assert(alignof(T) <= alignof(std::max_align_t), "Deferred format arguments must not be over-aligned");
+	using type = T;
+};
+
+template <>
+struct DeferredArgument<char *> {
+	using type = const char *;
+};
+
+template <>
+struct DeferredArgument<const char *> {
+	using type = const char *;
+};
+//! @endcond
 
 /**
- * Logger handler used to process log messages.
+ * Format string and a copy of the arguments for a log message that
+ * will be formatted when the text is first used.
  *
- * @since 1.0.0
+ * Arguments must be scalar types. Strings (`char *`) are copied but
+ * the contents of any other pointers are not. Flash strings must
+ * remain valid for the lifetime of the message.
+ *
+ * @tparam Args Types of the format string arguments.
+ * @since 4.0.0
  */
-class Handler {
-	/**
-	 * Logger needs to be able to access the private reference to
-	 * the registered log handlers.
-	 *
-	 * @since 2.1.2
-	 */
-	friend Logger;
+template <typename... Args>
+class DeferredFormat: public MessageFormat {
 public:
-	virtual ~Handler();
-
 	/**
-	 * Add a new log message.
-	 *
-	 * This should normally be put in a queue instead of being
-	 * processed immediately so that log messages have minimal impact
-	 * at the time of use.
-	 *
-	 * Handlers must avoid holding a lock on a mutex used for adding
-	 * messages while processing those messages. Release the lock while
-	 * performing the processing.
-	 *
-	 * Queues should have a maximum size and discard the oldest message
-	 * when full.
+	 * Capture a format string and its arguments.
 	 *
-	 * It is not safe for the handler to directly or indirectly do any
-	 * of the following while this function is being called:
-	 * - Log a message.
-	 * - Read the log level of any handler.
-	 * - Modify the log level of any handler.
-	 * - Unregister any handler.
-	 *
-	 * @param[in] message New log message, shared by all handlers.
-	 * @since 1.0.0
+	 * @param[in] format Format string.
+	 * @param[in] flash The format string is a flash string.
+	 * @param[in] args Format string arguments.
+	 * @since 4.0.0
 	 */
-	virtual void operator<<(std::shared_ptr<Message> message) = 0;
+	DeferredFormat(const char *format, bool flash, Args... args)
+			: format_(format), flash_(flash), args_(args...) {
+	}
+	~DeferredFormat() = default;
 
-protected:
-	Handler() = default;
+	size_t size() const override {
+		return sizeof(*this) + strings_size(Indices{});
+	}
+
+	const MessageFormat *store(void *storage) const override {
+		DeferredFormat *stored = ::new (storage) DeferredFormat(*this);
+
+		stored->copy_strings(static_cast<char *>(storage) + sizeof(*this), Indices{});
+		return stored;
+	}
+
+	int format(char *buffer, size_t size) const override {
+		return format(buffer, size, Indices{});
+	}
 
 private:
-	/**
-	 * Reference to registered log handlers.
-	 *
-	 * Used in the destructor to safely unregister the handler even if
-	 * the underlying map has already been destroyed.
-	 *
-	 * @since 2.1.2
+	//! @cond false
+	template <size_t... I>
+	struct IndexSequence {};
+
+	template <size_t N, size_t... I>
+	struct MakeIndexSequence: MakeIndexSequence<N - 1, N - 1, I...> {};
+
+	template <size_t... I>
+	struct MakeIndexSequence<0, I...> {
+		using type = IndexSequence<I...>;
+	};
+
+	using Indices = typename MakeIndexSequence<sizeof...(Args)>::type;
+
+	static size_t string_size(const char *value) {
+		return value ? ::strlen(value) + 1 : 0;
+	}
+
+	template <typename T>
+	static size_t string_size(const T&) {
+		return 0;
+	}
+
+	static void copy_string(const char *&value, char *&strings) {
+		if (value) {
+			size_t size = ::strlen(value) + 1;
+
+			std::memcpy(strings, value, size);
+			value = strings;
+			strings += size;
+		}
+	}
+
+	template <typename T>
+	static void copy_string(T&, char *&) {
+	}
+
+	template <size_t... I>
+	size_t strings_size(IndexSequence<I...>) const {
+		const size_t sizes[] = { 0, string_size(std::get<I>(args_))... };
+		size_t total = 0;
+
+		for (auto size : sizes) {
+			total += size;
+		}
+
+		return total;
+	}
+
+	template <size_t... I>
+	void copy_strings(char *strings, IndexSequence<I...>) {
+		const int copies[] = { 0, (copy_string(std::get<I>(args_), strings), 0)... };
+
+		(void)copies;
+		(void)strings;
+	}
+
+	/*
+	 * An additional unused argument is always passed so that there is
+	 * never a warning about using a format string without arguments.
 	 */
-	std::weak_ptr<std::map<Handler*,Level>> handlers_;
+	template <size_t... I>
+	int format(char *buffer, size_t size, IndexSequence<I...>) const {
+		if (flash_) {
+			return snprintf_P(buffer, size, reinterpret_cast<PGM_P>(format_), std::get<I>(args_)..., 0);
+		} else {
+			return snprintf(buffer, size, format_, std::get<I>(args_)..., 0);
+		}
+	}
+	//! @endcond
+
+	const char *format_; /*!< Format string. @since 4.0.0 */
+	const bool flash_; /*!< The format string is a flash string. @since 4.0.0 */
+	std::tuple<typename DeferredArgument<Args>::type...> args_; /*!< Format string arguments. @since 4.0.0 */
 };
 
 /**
- * Logger instance used to make log messages.
+ * Formatted text of a log message.
  *
- * @since 1.0.0
+ * Provides read-only access to the text in the same way as a
+ * std::string. The text is normally stored in the same allocation as
+ * the Message that it belongs to.
+ *
+ * If the message was logged with deferred formatting then the text
+ * will be formatted when it is first used and then cached.
+ *
+ * @since 4.0.0
  */
-class Logger {
+class MessageText {
+	/**
+	 * Message needs to be able to construct its text.
+	 *
+	 * @since 4.0.0
+	 */
+	friend Message;
 public:
 	/**
-	 * This is the maximum length of any log message.
+	 * Copy message text.
 	 *
-	 * Determines the size of the buffer used for format string
-	 * printing.
+	 * The copy will have its own storage for the text.
 	 *
-	 * @since 1.0.0
+	 * @param[in] other Message text to copy.
+	 * @since 4.0.0
 	 */
-	static constexpr size_t MAX_LOG_LENGTH = 255;
+	MessageText(const MessageText &other);
+	~MessageText();
+
+	MessageText& operator=(const MessageText&) = delete;
 
 	/**
-	 * Create a new logger with the given name and logging facility.
+	 * Get the text as a null-terminated string.
 	 *
-	 * @param[in] name Logger name (flash string).
-	 * @param[in] facility Default logging facility for messages.
-	 *
-	 * @since 1.0.0
+	 * @return Null-terminated text.
+	 * @since 4.0.0
 	 */
-	explicit Logger(const __FlashStringHelper *name, Facility facility = Facility::LOCAL0);
-	~Logger() = default;
+	inline const char *c_str() const {
+		const char *text = text_.load(std::memory_order_acquire);
+		return text ? text : format();
+	}
 
 	/**
-	 * Register a log handler.
-	 *
-	 * Call again to change the log level.
+	 * Get the text as a null-terminated string.
 	 *
-	 * @param[in] handler Handler object that will handle log
-	 *                    messages.
-	 * @param[in] level Minimum log level that the handler is
-	 *                  interested in.
-	 * @since 1.0.0
+	 * @return Null-terminated text.
+	 * @since 4.0.0
 	 */
-	static void register_handler(Handler *handler, Level level);
+	inline const char *data() const { return c_str(); }
 
 	/**
-	 * Unregister a log handler.
-	 *
-	 * It is safe to call this with a handler that is not registered.
+	 * Get the length of the text.
 	 *
-	 * @param[in] handler Handler object that will no longer handle
-	 *                    log messages.
-	 * @since 1.0.0
+	 * @return Length of the text, not including the null terminator.
+	 * @since 4.0.0
 	 */
-	static void unregister_handler(Handler *handler);
+	inline size_t length() const {
+		c_str();
+		return length_.load(std::memory_order_relaxed);
+	}
 
 	/**
-	 * Get the current log level of a handler.
-	 *
-	 * It is safe to call this with a handler that is not registered.
+	 * Get the length of the text.
 	 *
-	 * @param[in] handler Handler object that may handle log
-	 *                    messages.
-	 * @return The current log level of the specified handler.
-	 * @since 1.0.0
+	 * @return Length of the text, not including the null terminator.
+	 * @since 4.0.0
 	 */
-	static Level get_log_level(const Handler *handler);
+	inline size_t size() const { return length(); }
 
 	/**
-	 * Get the current global log level.
+	 * Determine if the text is empty.
 	 *
-	 * @return The minimum log level across all handlers.
-	 * @since 3.0.0
+	 * @return True if the text is empty, otherwise false.
+	 * @since 4.0.0
 	 */
-	static Level global_level() { return global_level_; };
+	inline bool empty() const { return length() == 0; }
 
 	/**
-	 * Determine if the specified log level is enabled by the effective
-	 * log level.
+	 * Copy the text to a std::string.
 	 *
-	 * @param[in] level Log level to check.
-	 * @return If the specified log level is enabled on this logger.
-	 * @since 3.0.0
+	 * @return A copy of the text.
+	 * @since 4.0.0
 	 */
-	inline bool enabled(Level level) const { return level <= global_level_ && level <= local_level_; }
+	inline operator std::string() const {
+		const char *text = c_str();
+		return std::string{text, length_.load(std::memory_order_relaxed)};
+	}
 
 	/**
-	 * Get the default logging facility for new messages of this logger.
+	 * Determine if the text has been formatted.
 	 *
-	 * @return The default logging facility for messages.
-	 * @since 2.3.0
+	 * @return True if the text has been formatted, otherwise false.
+	 * @since 4.0.0
 	 */
-	inline Facility facility() const { return facility_; }
+	inline bool formatted() const { return text_.load(std::memory_order_acquire) != nullptr; }
 
+private:
 	/**
-	 * Get the log level.
+	 * Create message text using separately allocated storage.
 	 *
-	 * The effective log level will be depend on handlers.
-	 *
-	 * @return The log level of this logger.
-	 * @since 3.0.0
+	 * @param[in] text Log message text.
+	 * @since 4.0.0
 	 */
-	inline Level level() const { return local_level_; }
+	explicit MessageText(const std::string &text);
 
 	/**
-	 * Set the log level.
-	 *
-	 * The effective log level will be depend on handlers.
+	 * Create message text using storage that is owned by the Message.
 	 *
-	 * @param[in] level Log level for this logger.
-	 * @since 3.0.0
+	 * @param[in] text Log message text (does not need to be null-terminated).
+	 * @param[in] length Length of the log message text.
+	 * @param[in] storage Storage for length + 1 characters.
+	 * @since 4.0.0
 	 */
-	inline void level(Level level) { local_level_ = level; }
+	MessageText(const char *text, size_t length, char *storage);
 
 	/**
-	 * Get the effective log level.
+	 * Create message text that will be formatted when it is first
+	 * used.
 	 *
-	 * @return The effective log level for this logger.
-	 * @since 3.0.0
+	 * The formatted text is stored in any spare space after the
+	 * arguments if it fits, otherwise it is allocated separately.
+	 *
+	 * @param[in] format Format string and arguments.
+	 * @param[in] spare_size Size of the spare space after the
+	 *                       arguments.
+	 * @param[in] storage Storage for format.size() + spare_size bytes.
+	 * @since 4.0.0
 	 */
-	Level effective_level() const { return std::min(global_level(), local_level_); };
+	MessageText(const MessageFormat &format, size_t spare_size, char *storage);
 
 	/**
-	 * Log a message at level Level::EMERG.
+	 * Format the text and cache the result.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @return Null-terminated text.
+	 * @since 4.0.0
 	 */
-	void emerg(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	const char *format() const;
+
+	std::unique_ptr<char[]> owned_; /*!< Separately allocated storage for the text. @since 4.0.0 */
+	const MessageFormat *format_ = nullptr; /*!< Format string and arguments, if the text has not been formatted in advance. @since 4.0.0 */
+	char *spare_ = nullptr; /*!< Spare storage for the formatted text. @since 4.0.0 */
+	size_t spare_size_ = 0; /*!< Size of the spare storage for the formatted text. @since 4.0.0 */
+	mutable std::atomic<bool> spare_used_{false}; /*!< The spare storage has been claimed for the formatted text. @since 4.0.0 */
+	mutable std::atomic<const char *> text_; /*!< Null-terminated text, or nullptr if it has not been formatted yet. @since 4.0.0 */
+	mutable std::atomic<size_t> length_; /*!< Length of the text. @since 4.0.0 */
+};
+
+/**
+ * Log message text with timestamp and logger attributes.
+ *
+ * These will be created when a message is logged and then passed to
+ * all registered handlers.
+ *
+ * @since 1.0.0
+ */
+struct Message {
 	/**
-	 * Log a message at level Level::EMERG.
+	 * Create a new log message (not directly useful).
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
+	 * The text will be copied to a separate allocation. Use
+	 * Message::create() to store the text in the same allocation as
+	 * the message.
+	 *
+	 * @param[in] uptime_ms System uptime, see uuid::get_uptime_ms().
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] name Logger name (flash string).
+	 * @param[in] text Log message text.
 	 * @since 1.0.0
 	 */
-	void emerg(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, std::string &&text);
+	~Message() = default;
 
 	/**
-	 * Log a message at level Level::ALERT.
+	 * Create a new log message.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * The message, its shared pointer control block and a copy of the
+	 * text are stored in a single allocation. This will be from the
+	 * MessagePool if it has been configured.
+	 *
+	 * @param[in] uptime_ms System uptime, see uuid::get_uptime_ms().
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] name Logger name (flash string).
+	 * @param[in] text Log message text (does not need to be null-terminated).
+	 * @param[in] length Length of the log message text.
+	 * @return A new log message, or an empty pointer if the
+	 *         MessagePool is exhausted and configured to drop messages.
+	 * @since 4.0.0
 	 */
-	void alert(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	static std::shared_ptr<Message> create(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const char *text, size_t length);
+
 	/**
-	 * Log a message at level Level::ALERT.
+	 * Create a new log message that will be formatted when the text is
+	 * first used.
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * The message, its shared pointer control block and a copy of the
+	 * format string arguments are stored in a single allocation. This
+	 * will be from the MessagePool if it has been configured.
+	 *
+	 * @param[in] uptime_ms System uptime, see uuid::get_uptime_ms().
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] name Logger name (flash string).
+	 * @param[in] format Format string and arguments.
+	 * @return A new log message, or an empty pointer if the
+	 *         MessagePool is exhausted and configured to drop messages.
+	 * @since 4.0.0
 	 */
-	void alert(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	static std::shared_ptr<Message> create(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const MessageFormat &format);
 
 	/**
-	 * Log a message at level Level::CRIT.
+	 * System uptime at the time the message was logged.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
+	 * @see uuid::get_uptime_ms()
 	 * @since 1.0.0
 	 */
-	void crit(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	const uint64_t uptime_ms;
+
 	/**
-	 * Log a message at level Level::CRIT.
+	 * Severity level of the message.
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
 	 * @since 1.0.0
 	 */
-	void crit(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	const Level level;
 
 	/**
-	 * Log a message at level Level::ERR.
+	 * Facility type of the process that logged the message.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
 	 * @since 1.0.0
 	 */
-	void err(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	const Facility facility;
+
 	/**
-	 * Log a message at level Level::ERR.
+	 * Name of the logger used (flash string).
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
 	 * @since 1.0.0
 	 */
-	void err(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	const __FlashStringHelper *name;
 
 	/**
-	 * Log a message at level Level::WARNING.
+	 * Formatted log message text.
+	 *
+	 * Does not include any of the other message attributes, those must
+	 * be added by the handler when outputting messages.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
 	 * @since 1.0.0
 	 */
-	void warning(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	const MessageText text;
+
+private:
 	/**
-	 * Log a message at level Level::WARNING.
+	 * MessagePool needs to be able to get the size of a message
+	 * allocation.
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @since 4.0.0
 	 */
-	void warning(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	friend class MessagePool;
 
 	/**
-	 * Log a message at level Level::NOTICE.
+	 * State of an allocation for a message.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @since 4.0.0
 	 */
-	void notice(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	struct Allocation;
+
 	/**
-	 * Log a message at level Level::NOTICE.
+	 * Allocator for a message with additional storage for its text.
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @since 4.0.0
 	 */
-	void notice(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	template <class T>
+	class Allocator;
 
 	/**
-	 * Log a message at level Level::INFO.
+	 * Get the size of the allocation for a message and its shared
+	 * pointer control block, not including the text.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @return Size of the allocation in bytes.
+	 * @since 4.0.0
 	 */
-	void info(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	static size_t allocation_size();
+
 	/**
-	 * Log a message at level Level::INFO.
+	 * Create a new log message with text stored in the same
+	 * allocation.
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
+	 * @param[in] uptime_ms System uptime, see uuid::get_uptime_ms().
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] name Logger name (flash string).
+	 * @param[in] text Log message text (does not need to be null-terminated).
+	 * @param[in] length Length of the log message text.
+	 * @param[in] storage Storage for length + 1 characters.
+	 * @since 4.0.0
 	 */
-	void info(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const char *text, size_t length, char *storage);
 
 	/**
-	 * Log a message at level Level::DEBUG.
+	 * Create a new log message with the format string arguments
+	 * stored in the same allocation.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @param[in] uptime_ms System uptime, see uuid::get_uptime_ms().
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] name Logger name (flash string).
+	 * @param[in] format Format string and arguments.
+	 * @param[in] spare_size Size of the spare space after the
+	 *                       arguments that can be used for the
+	 *                       formatted text.
+	 * @param[in] storage Storage for format.size() + spare_size bytes.
+	 * @since 4.0.0
 	 */
-	void debug(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	Message(uint64_t uptime_ms, Level level, Facility facility, const __FlashStringHelper *name, const MessageFormat &format, size_t spare_size, char *storage);
+};
+
+class Logger;
+
+/**
+ * Logger handler used to process log messages.
+ *
+ * @since 1.0.0
+ */
+class Handler {
 	/**
-	 * Log a message at level Level::DEBUG.
+	 * Logger needs to be able to access the private reference to
+	 * the registered log handlers.
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @since 2.1.2
 	 */
-	void debug(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	friend Logger;
+public:
+	virtual ~Handler();
 
 	/**
-	 * Log a message at level Level::TRACE.
+	 * Add a new log message.
 	 *
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
+	 * This should normally be put in a queue instead of being
+	 * processed immediately so that log messages have minimal impact
+	 * at the time of use.
+	 *
+	 * Handlers must avoid holding a lock on a mutex used for adding
+	 * messages while processing those messages. Release the lock while
+	 * performing the processing.
+	 *
+	 * Queues should have a maximum size and discard the oldest message
+	 * when full.
+	 *
+	 * It is not safe for the handler to directly or indirectly do any
+	 * of the following while this function is being called:
+	 * - Log a message.
+	 * - Read the log level of any handler.
+	 * - Modify the log level of any handler.
+	 * - Unregister any handler.
+	 *
+	 * @param[in] message New log message, shared by all handlers.
 	 * @since 1.0.0
 	 */
-	void trace(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	virtual void operator<<(std::shared_ptr<Message> message) = 0;
+
+protected:
+	Handler() = default;
+
+private:
 	/**
-	 * Log a message at level Level::TRACE.
+	 * Registered log handlers, their log levels and the handlers that
+	 * are interested in each log level.
 	 *
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @since 4.0.0
 	 */
-	void trace(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	struct Handlers;
 
 	/**
-	 * Log a message with default facility.
+	 * Registered log handlers.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
-	 * @since 3.0.0
+	 * @since 4.0.0
 	 */
-	void log(Level level, const char *format, ...) const /* __attribute__((format (printf, 3, 4))) */;
+	struct Registry;
+
 	/**
-	 * Log a message with default facility.
+	 * Reference to registered log handlers.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
-	 * @since 3.0.0
+	 * Used in the destructor to safely unregister the handler even if
+	 * the underlying registry has already been destroyed.
+	 *
+	 * @since 2.1.2
 	 */
-	void log(Level level, const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 3, 4))) */;
+	std::weak_ptr<Registry> handlers_;
 
+	std::atomic<Level> level_{Level::OFF}; /*!< Log level of this handler while it is registered. @since 4.0.0 */
+	std::atomic<uint32_t> facilities_{ALL_FACILITIES}; /*!< Mask of logging facilities that this handler is interested in. @since 4.0.0 */
+};
+
+class CallSite;
+
+/**
+ * Logger instance used to make log messages.
+ *
+ * @since 1.0.0
+ */
+class Logger {
 	/**
-	 * Log a message with a custom facility.
+	 * CallSite needs to be able to check the generation of log levels
+	 * and log messages without checking the level of this logger.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] format Format string.
-	 * @param[in] ... Format string arguments.
-	 * @since 1.0.0
+	 * @since 4.0.0
 	 */
-	void log(Level level, Facility facility, const char *format, ...) const /* __attribute__((format (printf, 4, 5))) */;
+	friend CallSite;
+public:
 	/**
-	 * Log a message with a custom facility.
+	 * This is the maximum length of any log message.
+	 *
+	 * Determines the size of the buffer used for format string
+	 * printing. This buffer is allocated on the stack while the
+	 * message is formatted.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ... Format string arguments.
 	 * @since 1.0.0
 	 */
-	void log(Level level, Facility facility, const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 4, 5))) */;
+	static constexpr size_t MAX_LOG_LENGTH = 255;
 
 	/**
-	 * Log a message at the specified level.
+	 * Create a new logger with the given name and logging facility.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] format Format string.
-	 * @param[in] ap Variable arguments pointer for format string.
-	 * @since 3.1.0
+	 * @param[in] name Logger name (flash string).
+	 * @param[in] facility Default logging facility for messages.
+	 *
+	 * @since 1.0.0
 	 */
-	void vlog(Level level, const char *format, va_list ap) const;
+	explicit Logger(const __FlashStringHelper *name, Facility facility = Facility::LOCAL0);
+	~Logger();
+
+	/*
+	 * Loggers can't be copied or moved because their level is atomic
+	 * and their address is kept by the registry and by call sites.
+	 */
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
 	/**
-	 * Log a message at the specified level.
+	 * Register a log handler for messages of all facilities.
 	 *
-	 * @param[in] level Severity level of the message.
+	 * Call again to change the log level.
+	 *
+	 * Waits until any messages that are being dispatched concurrently
+	 * have been passed to all handlers. Must not be called from a
+	 * handler while it is processing a message.
+	 *
+	 * @param[in] handler Handler object that will handle log
+	 *                    messages.
+	 * @param[in] level Minimum log level that the handler is
+	 *                  interested in.
+	 * @since 1.0.0
+	 */
+	static void register_handler(Handler *handler, Level level);
+
+	/**
+	 * Register a log handler for messages of some facilities.
+	 *
+	 * Call again to change the log level or facilities. Messages with
+	 * other facilities will not be passed to the handler, and will not
+	 * be formatted at all if no other handler is interested in them.
+	 *
+	 * Waits until any messages that are being dispatched concurrently
+	 * have been passed to all handlers. Must not be called from a
+	 * handler while it is processing a message.
+	 *
+	 * @param[in] handler Handler object that will handle log
+	 *                    messages.
+	 * @param[in] level Minimum log level that the handler is
+	 *                  interested in.
+	 * @param[in] facilities Mask of logging facilities that the
+	 *                       handler is interested in, see
+	 *                       uuid::log::facility_mask().
+	 * @since 4.0.0
+	 */
+	static void register_handler(Handler *handler, Level level, uint32_t facilities);
+
+	/**
+	 * Unregister a log handler.
+	 *
+	 * It is safe to call this with a handler that is not registered.
+	 *
+	 * Waits until any messages that are being dispatched concurrently
+	 * have been passed to all handlers, so that the handler can be
+	 * destroyed afterwards. Must not be called from a handler while it
+	 * is processing a message.
+	 *
+	 * @param[in] handler Handler object that will no longer handle
+	 *                    log messages.
+	 * @since 1.0.0
+	 */
+	static void unregister_handler(Handler *handler);
+
+	/**
+	 * Get the current log level of a handler.
+	 *
+	 * It is safe to call this with a handler that is not registered.
+	 *
+	 * @param[in] handler Handler object that may handle log
+	 *                    messages.
+	 * @return The current log level of the specified handler.
+	 * @since 1.0.0
+	 */
+	static Level get_log_level(const Handler *handler);
+
+	/**
+	 * Get the logging facilities of a handler.
+	 *
+	 * It is safe to call this with a handler that is not registered.
+	 *
+	 * @param[in] handler Handler object that may handle log
+	 *                    messages.
+	 * @return Mask of logging facilities that the specified handler is
+	 *         interested in.
+	 * @since 4.0.0
+	 */
+	static uint32_t get_facilities(const Handler *handler);
+
+	/**
+	 * Register a logger so that its level can be configured by name.
+	 *
+	 * Registration is optional and is only needed to use
+	 * find_logger(), configure_level() and configure_levels(). It is
+	 * safe to call this with a logger that is already registered.
+	 * Loggers are unregistered automatically when they are destroyed.
+	 *
+	 * @param[in] logger Logger to register.
+	 * @since 4.0.0
+	 */
+	static void register_logger(Logger *logger);
+
+	/**
+	 * Unregister a logger.
+	 *
+	 * It is safe to call this with a logger that is not registered.
+	 *
+	 * @param[in] logger Logger to unregister.
+	 * @since 4.0.0
+	 */
+	static void unregister_logger(Logger *logger);
+
+	/**
+	 * Find a registered logger by name.
+	 *
+	 * @param[in] name Name of the logger.
+	 * @return The first registered logger with that name, or nullptr
+	 *         if there is no registered logger with that name.
+	 * @since 4.0.0
+	 */
+	static Logger *find_logger(const char *name);
+
+	/**
+	 * Set the level of all registered loggers with names that match a
+	 * pattern.
+	 *
+	 * The pattern can contain "*" to match any number of characters
+	 * and "?" to match any single character.
+	 *
+	 * @param[in] pattern Pattern to match logger names.
+	 * @param[in] level Log level for the loggers.
+	 * @return The number of loggers that matched the pattern.
+	 * @since 4.0.0
+	 */
+	static size_t configure_level(const char *pattern, Level level);
+
+	/**
+	 * Set the level of registered loggers from a specification
+	 * string.
+	 *
+	 * The specification is a comma-separated list of "pattern=level"
+	 * entries (e.g. "wifi=debug,mqtt=warning,sensor.*=info"), where
+	 * the pattern is the same as configure_level() and the level name
+	 * is uppercase or lowercase. An entry without a pattern sets the
+	 * level of all registered loggers. Entries are applied in order so
+	 * later entries override earlier ones.
+	 *
+	 * No levels are changed if any entry is invalid.
+	 *
+	 * @param[in] spec Specification of the log levels.
+	 * @return True if the specification is valid, otherwise false.
+	 * @since 4.0.0
+	 */
+	static bool configure_levels(const char *spec);
+
+	/**
+	 * Get the current global log level.
+	 *
+	 * @return The minimum log level across all handlers.
+	 * @since 3.0.0
+	 */
+	static Level global_level() { return global_level_; };
+
+	/**
+	 * Get the current global log level of a logging facility.
+	 *
+	 * @param[in] facility Logging facility.
+	 * @return The minimum log level across all handlers that are
+	 *         interested in the facility.
+	 * @since 4.0.0
+	 */
+	static Level global_level(Facility facility) {
+		return facility < NUM_FACILITIES ? facility_levels_[facility].load() : global_level_.load();
+	};
+
+	/**
+	 * Get the name of this logger.
+	 *
+	 * @return Logger name (flash string).
+	 * @since 4.0.0
+	 */
+	inline const __FlashStringHelper *name() const { return name_; }
+
+	/**
+	 * Determine if the specified log level is enabled by the effective
+	 * log level.
+	 *
+	 * @param[in] level Log level to check.
+	 * @return If the specified log level is enabled on this logger.
+	 * @since 3.0.0
+	 */
+	inline bool enabled(Level level) const { return enabled(level, facility_); }
+
+	/**
+	 * Determine if the specified log level is enabled by the effective
+	 * log level for messages with a specific logging facility.
+	 *
+	 * @param[in] level Log level to check.
+	 * @param[in] facility Logging facility of the message.
+	 * @return If the specified log level is enabled on this logger for
+	 *         the logging facility.
+	 * @since 4.0.0
+	 */
+	inline bool enabled(Level level, Facility facility) const {
+		return level <= min_level && level <= global_level(facility) && level <= local_level_;
+	}
+
+	/**
+	 * Get the default logging facility for new messages of this logger.
+	 *
+	 * @return The default logging facility for messages.
+	 * @since 2.3.0
+	 */
+	inline Facility facility() const { return facility_; }
+
+	/**
+	 * Get the log level.
+	 *
+	 * The effective log level will be depend on handlers.
+	 *
+	 * @return The log level of this logger.
+	 * @since 3.0.0
+	 */
+	inline Level level() const { return local_level_; }
+
+	/**
+	 * Set the log level.
+	 *
+	 * The effective log level will be depend on handlers.
+	 *
+	 * @param[in] level Log level for this logger.
+	 * @since 3.0.0
+	 */
+	inline void level(Level level) { local_level_ = level; generation_++; }
+
+	/**
+	 * Get the effective log level.
+	 *
+	 * @return The effective log level for this logger.
+	 * @since 3.0.0
+	 */
+	Level effective_level() const { return std::min({global_level(facility_), level(), min_level}); };
+
+	/**
+	 * Limit the rate of messages logged by this logger.
+	 *
+	 * Uses a token bucket that is checked before the message is
+	 * formatted. Messages that exceed the limit are discarded and
+	 * counted. When messages are allowed again, a single message with
+	 * the number of discarded messages is logged first.
+	 *
+	 * The rate limit is disabled by default.
+	 *
+	 * @param[in] rate Maximum average number of messages per second
+	 *                 (0 to disable the rate limit).
+	 * @param[in] burst Maximum number of messages that can be logged
+	 *                  at once.
+	 * @since 4.0.0
+	 */
+	void rate_limit(unsigned int rate, unsigned int burst);
+
+	/**
+	 * Get the number of messages discarded by the rate limit.
+	 *
+	 * @return The total number of messages discarded by the rate
+	 *         limit of this logger.
+	 * @since 4.0.0
+	 */
+	unsigned long suppressed_messages() const;
+
+	/**
+	 * Log a message at level Level::EMERG.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void emerg(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::EMERG.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void emerg(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message at level Level::ALERT.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void alert(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::ALERT.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void alert(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message at level Level::CRIT.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void crit(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::CRIT.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void crit(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message at level Level::ERR.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void err(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::ERR.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void err(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message at level Level::WARNING.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void warning(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::WARNING.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void warning(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message at level Level::NOTICE.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void notice(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::NOTICE.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void notice(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message at level Level::INFO.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void info(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::INFO.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 */
+	void info(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message at level Level::DEBUG.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void debug(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::DEBUG.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void debug(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message at level Level::TRACE.
+	 *
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void trace(const char *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+	/**
+	 * Log a message at level Level::TRACE.
+	 *
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void trace(const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 2, 3))) */;
+
+	/**
+	 * Log a message with default facility.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 3.0.0
+	 */
+	void log(Level level, const char *format, ...) const /* __attribute__((format (printf, 3, 4))) */;
+	/**
+	 * Log a message with default facility.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 3.0.0
+	 */
+	void log(Level level, const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 3, 4))) */;
+
+	/**
+	 * Log a message with a custom facility.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void log(Level level, Facility facility, const char *format, ...) const /* __attribute__((format (printf, 4, 5))) */;
+	/**
+	 * Log a message with a custom facility.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ... Format string arguments.
+	 * @since 1.0.0
+	 */
+	void log(Level level, Facility facility, const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 4, 5))) */;
+
+	/**
+	 * Log a message at the specified level.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] format Format string.
+	 * @param[in] ap Variable arguments pointer for format string.
+	 * @since 3.1.0
+	 */
+	void vlog(Level level, const char *format, va_list ap) const;
+	/**
+	 * Log a message at the specified level.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ap Variable arguments pointer for format string.
+	 * @since 3.1.0
+	 */
+	void vlog(Level level, const __FlashStringHelper *format, va_list ap) const;
+
+	/**
+	 * Log a message at the specified level and facility.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string.
+	 * @param[in] ap Variable arguments pointer for format string.
+	 * @since 3.1.0
+	 */
+	void vlog(Level level, Facility facility, const char *format, va_list ap) const;
+	/**
+	 * Log a message at the specified level and facility.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ap Variable arguments pointer for format string.
+	 * @since 3.1.0
+	 */
+	void vlog(Level level, Facility facility, const __FlashStringHelper *format, va_list ap) const;
+
+	/**
+	 * Log a plain message (without formatting) at the specified level.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] text Text for the message.
+	 * @since 3.1.0
+	 */
+	void logp(Level level, const char *text) const;
+	/**
+	 * Log an plain message (without formatting) at the specified level and
+	 * facility.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] text Text for the message.
+	 * @since 3.1.0
+	 */
+	void logp(Level level, Facility facility, const char *text) const;
+
+	/**
+	 * Log a message with deferred formatting at the specified level.
+	 *
+	 * A copy of the arguments is stored in the message and it will be
+	 * formatted when a handler first uses the text. Arguments must be
+	 * scalar types, strings (`char *`) are copied.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] format Format string.
+	 * @param[in] args Format string arguments.
+	 * @since 4.0.0
+	 */
+	template <typename... Args>
+	inline void logd(Level level, const char *format, Args... args) const {
+		if (level <= min_level) {
+			log_deferred(level, facility_, DeferredFormat<Args...>{format, false, args...});
+		}
+	}
+	/**
+	 * Log a message with deferred formatting at the specified level.
+	 *
+	 * A copy of the arguments is stored in the message and it will be
+	 * formatted when a handler first uses the text. Arguments must be
+	 * scalar types, strings (`char *`) are copied.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] format Format string (flash string).
+	 * @param[in] args Format string arguments.
+	 * @since 4.0.0
+	 */
+	template <typename... Args>
+	inline void logd(Level level, const __FlashStringHelper *format, Args... args) const {
+		if (level <= min_level) {
+			log_deferred(level, facility_, DeferredFormat<Args...>{reinterpret_cast<const char *>(format), true, args...});
+		}
+	}
+
+	/**
+	 * Log a message with deferred formatting at the specified level
+	 * and facility.
+	 *
+	 * A copy of the arguments is stored in the message and it will be
+	 * formatted when a handler first uses the text. Arguments must be
+	 * scalar types, strings (`char *`) are copied.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string.
+	 * @param[in] args Format string arguments.
+	 * @since 4.0.0
+	 */
+	template <typename... Args>
+	inline void logd(Level level, Facility facility, const char *format, Args... args) const {
+		if (level <= min_level) {
+			log_deferred(level, facility, DeferredFormat<Args...>{format, false, args...});
+		}
+	}
+	/**
+	 * Log a message with deferred formatting at the specified level
+	 * and facility.
+	 *
+	 * A copy of the arguments is stored in the message and it will be
+	 * formatted when a handler first uses the text. Arguments must be
+	 * scalar types, strings (`char *`) are copied.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string (flash string).
+	 * @param[in] args Format string arguments.
+	 * @since 4.0.0
+	 */
+	template <typename... Args>
+	inline void logd(Level level, Facility facility, const __FlashStringHelper *format, Args... args) const {
+		if (level <= min_level) {
+			log_deferred(level, facility, DeferredFormat<Args...>{reinterpret_cast<const char *>(format), true, args...});
+		}
+	}
+
+private:
+	/**
+	 * Rate limit state.
+	 *
+	 * @since 4.0.0
+	 */
+	struct RateLimit;
+
+	/**
+	 * Check the rate limit for a message, logging the number of
+	 * discarded messages if it is allowed after messages have been
+	 * discarded.
+	 *
+	 * The number of discarded messages is logged with the level and
+	 * facility of the message that is allowed.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Logging facility of the message.
+	 * @return True if the message must be discarded, otherwise false.
+	 * @since 4.0.0
+	 */
+	bool rate_limited(Level level, Facility facility) const;
+
+	/**
+	 * Log a message at the specified level and facility without checking that
+	 * the specified level is enabled.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string.
+	 * @param[in] ap Variable arguments pointer for format string.
+	 * @since 3.1.0
+	 */
+	void vlog_internal(Level level, Facility facility, const char *format, va_list ap) const;
+	/**
+	 * Log a message at the specified level and facility without checking that
+	 * the specified level is enabled.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string (flash string).
+	 * @param[in] ap Variable arguments pointer for format string.
+	 * @since 3.1.0
+	 */
+	void vlog_internal(Level level, Facility facility, const __FlashStringHelper *format, va_list ap) const;
+
+	/**
+	 * Log a message with deferred formatting at the specified level
+	 * and facility.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] format Format string and arguments.
+	 * @since 4.0.0
+	 */
+	void log_deferred(Level level, Facility facility, const MessageFormat &format) const;
+
+	/**
+	 * Refresh the minimum global log level across all handlers and
+	 * the handlers that are interested in each log level.
+	 *
+	 * @param[in] handlers Registered log handlers.
+	 * @since 1.0.0
+	 */
+	static void refresh_log_level(Handler::Handlers &handlers);
+	/**
+	 * Get registered log handlers.
+	 *
+	 * @return The registered log handlers.
+	 * @since 2.1.2
+	 */
+	static std::shared_ptr<Handler::Registry>& registered_handlers();
+
+	/**
+	 * Publish a new copy of the registered log handlers for use by
+	 * dispatch() and delete the previous copy when it is no longer in
+	 * use.
+	 *
+	 * @param[in] registry Registered log handlers.
+	 * @param[in] handlers New copy of the registered log handlers.
+	 * @since 4.0.0
+	 */
+	static void publish_handlers(Handler::Registry &registry, std::unique_ptr<Handler::Handlers> handlers);
+
+	/**
+	 * Wait until there are no dispatch() calls using a previous copy of
+	 * the registered log handlers.
+	 *
+	 * @param[in] registry Registered log handlers.
+	 * @since 4.0.0
+	 */
+	static void wait_for_dispatch(Handler::Registry &registry);
+
+	/**
+	 * Dispatch a log message to all handlers that are registered to
+	 * handle messages of the specified level.
+	 *
+	 * Automatically sets the timestamp of the message to the current
+	 * system uptime.
+	 *
+	 * @param[in] level Severity level of the message.
+	 * @param[in] facility Facility type of the process logging the message.
+	 * @param[in] text Log message text (does not need to be null-terminated).
+	 * @param[in] length Length of the log message text.
+	 * @since 4.0.0
+	 */
+	void dispatch(Level level, Facility facility, const char *text, size_t length) const;
+
+	/**
+	 * Dispatch a log message to all handlers that are registered to
+	 * handle messages of the specified level.
+	 *
+	 * Uses the current copy of the registered log handlers without
+	 * locking the mutex, so that handlers can be called concurrently.
+	 *
+	 * @param[in] message Log message (ignored if empty).
+	 * @since 3.1.0
+	 */
+	void dispatch(const std::shared_ptr<Message> &message) const;
+
+	/**
+	 * Set the level of all registered loggers with names that match a
+	 * pattern. The registry must already be locked.
+	 *
+	 * @param[in] pattern Pattern to match logger names.
+	 * @param[in] length Length of the pattern.
+	 * @param[in] level Log level for the loggers.
+	 * @return The number of loggers that matched the pattern.
+	 * @since 4.0.0
+	 */
+	static size_t configure_level(const char *pattern, size_t length, Level level);
+
+	static std::atomic<Level> global_level_; /*!< Minimum global log level across all handlers. @since 3.0.0 */
+	static std::array<std::atomic<Level>,NUM_FACILITIES> facility_levels_; /*!< Minimum global log level of each facility across all handlers. @since 4.0.0 */
+	static std::atomic<uint32_t> generation_; /*!< Incremented whenever log levels change, so that cached CallSite states are refreshed. @since 4.0.0 */
+#if UUID_LOG_THREAD_SAFE
+	static std::mutex mutex_; /*!< Mutex for changes to handlers. @since 2.3.0 */
+#endif
+
+	const __FlashStringHelper *name_; /*!< Logger name (flash string). @since 1.0.0 */
+	const Facility facility_; /*!< Default logging facility for messages. @since 1.0.0 */
+	std::atomic<Level> local_level_{Level::ALL}; /*!< Logger level. @since 3.0.0 */
+	std::atomic<bool> registered_{false}; /*!< Logger is registered so that it can be found by name. @since 4.0.0 */
+	std::atomic<RateLimit*> rate_limit_{nullptr}; /*!< Rate limit (if configured). @since 4.0.0 */
+};
+
+/**
+ * Fixed-capacity pool of storage for log messages.
+ *
+ * Messages are allocated from the heap by default. Configure the pool
+ * at startup to allocate all of its storage at once so that logging
+ * messages does not fragment the heap.
+ *
+ * Each slot in the pool contains one message, its shared pointer
+ * control block and its text.
+ *
+ * @since 4.0.0
+ */
+class MessagePool {
+	/**
+	 * Message needs to be able to allocate from the pool.
+	 *
+	 * @since 4.0.0
+	 */
+	friend Message;
+public:
+	/**
+	 * Action to take when a message can't be allocated from the pool.
+	 *
+	 * This happens when all of the slots are in use or the text is
+	 * too long to fit in a slot.
+	 *
+	 * @since 4.0.0
+	 */
+	enum Policy : uint8_t {
+		DROP = 0, /*!< Discard the message. @since 4.0.0 */
+		HEAP, /*!< Allocate the message from the heap. @since 4.0.0 */
+	};
+
+	MessagePool() = delete;
+
+	/**
+	 * Configure the pool.
+	 *
+	 * The pool can't be reconfigured while any of its slots are in
+	 * use. Messages created while the pool is being configured are
+	 * allocated from the heap.
+	 *
+	 * @param[in] count Number of slots in the pool, or 0 to disable
+	 *                  the pool and allocate all messages from the
+	 *                  heap.
+	 * @param[in] policy Action to take when a message can't be
+	 *                   allocated from the pool.
+	 * @param[in] text_length Maximum length of text in each slot.
+	 *                        Messages with deferred formatting use
+	 *                        this space for their arguments and
+	 *                        then for their formatted text if it
+	 *                        fits in the remaining space, otherwise
+	 *                        the formatted text is allocated from the
+	 *                        heap.
+	 * @return True if the pool was configured, otherwise false.
+	 * @since 4.0.0
+	 */
+	static bool configure(size_t count, Policy policy = Policy::HEAP, size_t text_length = Logger::MAX_LOG_LENGTH);
+
+	/**
+	 * Get the number of slots in the pool.
+	 *
+	 * @return The number of slots in the pool.
+	 * @since 4.0.0
+	 */
+	static size_t count();
+
+	/**
+	 * Get the number of slots in the pool that are not in use.
+	 *
+	 * @return The number of available slots in the pool.
+	 * @since 4.0.0
+	 */
+	static size_t available();
+
+	/**
+	 * Get the number of messages allocated from the pool.
+	 *
+	 * @return The number of messages allocated from the pool.
+	 * @since 4.0.0
+	 */
+	static unsigned long pool_allocations();
+
+	/**
+	 * Get the number of messages allocated from the heap because
+	 * they could not be allocated from the pool.
+	 *
+	 * @return The number of messages allocated from the heap.
+	 * @since 4.0.0
+	 */
+	static unsigned long heap_allocations();
+
+	/**
+	 * Get the number of messages discarded because they could not be
+	 * allocated from the pool.
+	 *
+	 * @return The number of messages discarded.
+	 * @since 4.0.0
+	 */
+	static unsigned long dropped_messages();
+
+private:
+	/**
+	 * Allocate a slot for a message.
+	 *
+	 * @param[in] size Size of the storage required for the message
+	 *                 text (including the null terminator) or
+	 *                 deferred format string arguments.
+	 * @param[out] drop The message must be discarded.
+	 * @return Storage for the message, or nullptr if the message must
+	 *         be allocated from the heap or discarded.
+	 * @since 4.0.0
+	 */
+	static void *allocate(size_t size, bool &drop);
+
+	/**
+	 * Release a slot used by a message.
+	 *
+	 * @param[in] ptr Storage for the message, which must have been
+	 *                allocated from the pool.
+	 * @since 4.0.0
+	 */
+	static void release(void *ptr);
+
+	static constexpr uint32_t NO_SLOT = UINT32_MAX; /*!< Index used to terminate the free list. @since 4.0.0 */
+	static constexpr size_t CONFIGURING = SIZE_MAX / 2 + 1; /*!< Added to the number of users while the pool is being configured. @since 4.0.0 */
+
+#if UUID_LOG_THREAD_SAFE
+	static std::mutex mutex_; /*!< Mutex for configuring the pool. @since 4.0.0 */
+#endif
+	static std::unique_ptr<char[]> storage_; /*!< Storage for all slots. @since 4.0.0 */
+	static std::unique_ptr<std::atomic<uint32_t>[]> next_; /*!< Index of the next available slot after each slot. @since 4.0.0 */
+	static size_t slot_size_; /*!< Size of each slot in bytes. @since 4.0.0 */
+	static size_t text_length_; /*!< Maximum length of text in each slot. @since 4.0.0 */
+	static std::atomic<size_t> count_; /*!< Number of slots. @since 4.0.0 */
+	static std::atomic<size_t> users_; /*!< Number of slots in use or being allocated. @since 4.0.0 */
+	static std::atomic<uint64_t> free_; /*!< Index of the first available slot (low 32 bits) and the number of changes to it (high 32 bits). @since 4.0.0 */
+	static Policy policy_; /*!< Action to take when a message can't be allocated from the pool. @since 4.0.0 */
+	static std::atomic<unsigned long> pool_allocations_; /*!< Number of messages allocated from the pool. @since 4.0.0 */
+	static std::atomic<unsigned long> heap_allocations_; /*!< Number of messages allocated from the heap. @since 4.0.0 */
+	static std::atomic<unsigned long> dropped_messages_; /*!< Number of messages discarded. @since 4.0.0 */
+};
+
+/**
+ * Call site that logs messages, with a cached decision of whether its
+ * log level is enabled.
+ *
+ * The cached decision is refreshed when the generation of log levels
+ * changes, so a disabled call site only needs to compare two relaxed
+ * atomic loads.
+ *
+ * Each call site can also be enabled or disabled at runtime, regardless
+ * of the log level of its logger. Call sites are registered so that
+ * they can be found by file and line number when they are first
+ * reached.
+ *
+ * Normally used through the UUID_LOG_SITE() macro, which creates a
+ * static instance for each call site.
+ *
+ * @since 4.0.0
+ */
+class CallSite {
+public:
+	/**
+	 * Whether a call site is enabled.
+	 *
+	 * @since 4.0.0
+	 */
+	enum Mode : uint8_t {
+		DEFAULT = 0, /*!< Enabled if its level is enabled by its logger. @since 4.0.0 */
+		ENABLED, /*!< Enabled if its level is enabled by any handler of the facility of its logger, regardless of the level of its logger. @since 4.0.0 */
+		DISABLED, /*!< Always disabled. @since 4.0.0 */
+	};
+
+	/**
+	 * Create a new call site.
+	 *
+	 * @param[in] file Source file name.
+	 * @param[in] line Source line number.
+	 * @since 4.0.0
+	 */
+	constexpr CallSite(const char *file, unsigned int line) : file_(file), line_(line) {}
+
+	/**
+	 * Get the first registered call site.
+	 *
+	 * @return The first registered call site, or nullptr if there are
+	 *         none.
+	 * @since 4.0.0
+	 */
+	static CallSite *first() { return first_.load(std::memory_order_acquire); }
+
+	/**
+	 * Set the mode of registered call sites in a source file.
+	 *
+	 * @param[in] file Source file name (or suffix of the name, starting
+	 *                 after a '/').
+	 * @param[in] line Source line number (0 for all lines).
+	 * @param[in] mode Whether the call sites are enabled.
+	 * @return The number of call sites that were changed.
+	 * @since 4.0.0
+	 */
+	static size_t mode(const char *file, unsigned int line, Mode mode);
+
+	/**
+	 * Get the next registered call site.
+	 *
+	 * @return The next registered call site, or nullptr if this is
+	 *         the last one.
+	 * @since 4.0.0
+	 */
+	inline CallSite *next() const { return next_; }
+
+	/**
+	 * Get the source file name.
+	 *
+	 * @return Source file name of the call site.
+	 * @since 4.0.0
+	 */
+	inline const char *file() const { return file_; }
+
+	/**
+	 * Get the source line number.
+	 *
+	 * @return Source line number of the call site.
+	 * @since 4.0.0
+	 */
+	inline unsigned int line() const { return line_; }
+
+	/**
+	 * Get whether this call site is enabled.
+	 *
+	 * @return The mode of this call site.
+	 * @since 4.0.0
+	 */
+	inline Mode mode() const { return mode_; }
+
+	/**
+	 * Set whether this call site is enabled.
+	 *
+	 * @param[in] mode Whether this call site is enabled.
+	 * @since 4.0.0
+	 */
+	void mode(Mode mode);
+
+	/**
+	 * Determine if messages from this call site are enabled, using
+	 * the cached decision if log levels have not changed.
+	 *
+	 * The decision is only cached for the first logger used with this
+	 * call site. If the call site is used with other loggers then
+	 * their levels are checked on every call.
+	 *
+	 * @param[in] logger Logger used by this call site.
+	 * @param[in] level Log level of this call site.
+	 * @return True if messages from this call site are enabled,
+	 *         otherwise false.
+	 * @since 4.0.0
+	 */
+	inline bool enabled(const Logger &logger, Level level) {
+		uint32_t state = state_.load(std::memory_order_relaxed);
+
+		if ((state >> 1) == (Logger::generation_.load(std::memory_order_relaxed) & GENERATION_MASK)
+				&& logger_.load(std::memory_order_relaxed) == &logger) {
+			return state & 1;
+		}
+
+		return refresh(logger, level);
+	}
+
+	/**
+	 * Log a message from this call site without checking that it is
+	 * enabled.
+	 *
+	 * @param[in] logger Logger used by this call site.
+	 * @param[in] level Log level of this call site.
+	 * @param[in] format Format string.
+	 * @param[in] ... Format string arguments.
+	 * @since 4.0.0
+	 */
+	void log(const Logger &logger, Level level, const char *format, ...) const /* __attribute__((format (printf, 4, 5))) */;
+	/**
+	 * Log a message from this call site without checking that it is
+	 * enabled.
+	 *
+	 * @param[in] logger Logger used by this call site.
+	 * @param[in] level Log level of this call site.
 	 * @param[in] format Format string (flash string).
-	 * @param[in] ap Variable arguments pointer for format string.
-	 * @since 3.1.0
+	 * @param[in] ... Format string arguments.
+	 * @since 4.0.0
+	 */
+	void log(const Logger &logger, Level level, const __FlashStringHelper *format, ...) const /* __attribute__((format (printf, 4, 5))) */;
+
+private:
+	static constexpr uint32_t GENERATION_MASK = UINT32_MAX >> 1; /*!< Bits of the generation stored in the cached state. @since 4.0.0 */
+
+	/**
+	 * Refresh the cached decision of whether this call site is enabled
+	 * and register it if it has not been registered.
+	 *
+	 * @param[in] logger Logger used by this call site.
+	 * @param[in] level Log level of this call site.
+	 * @return True if messages from this call site are enabled,
+	 *         otherwise false.
+	 * @since 4.0.0
+	 */
+	bool refresh(const Logger &logger, Level level);
+
+	static std::atomic<CallSite*> first_; /*!< First registered call site. @since 4.0.0 */
+
+	const char *file_; /*!< Source file name. @since 4.0.0 */
+	const unsigned int line_; /*!< Source line number. @since 4.0.0 */
+	CallSite *next_{nullptr}; /*!< Next registered call site. @since 4.0.0 */
+	std::atomic<bool> registered_{false}; /*!< Call site has been registered. @since 4.0.0 */
+	std::atomic<Mode> mode_{Mode::DEFAULT}; /*!< Whether this call site is enabled. @since 4.0.0 */
+	std::atomic<const Logger*> logger_{nullptr}; /*!< Logger that the cached decision applies to. @since 4.0.0 */
+	std::atomic<uint32_t> state_{0}; /*!< Generation of the cached decision (upper bits) and whether it is enabled (lowest bit). @since 4.0.0 */
+};
+
+/**
+ * Sampling state for a single call site that logs messages, used to
+ * log only some of the messages.
+ *
+ * Normally used through the UUID_LOG_EVERY_N() and UUID_LOG_EVERY_MS()
+ * macros, which create a static instance for each call site.
+ *
+ * @since 4.0.0
+ */
+class Sampler {
+public:
+	constexpr Sampler() = default;
+
+	/**
+	 * Determine if a message should be logged, so that only 1 in N
+	 * messages are logged (starting with the first message).
+	 *
+	 * @param[in] n Log 1 in this number of messages.
+	 * @return True if the message should be logged, otherwise false.
+	 * @since 4.0.0
+	 */
+	inline bool every(unsigned long n) {
+		return count_.fetch_add(1, std::memory_order_relaxed) % std::max(1UL, n) == 0;
+	}
+
+	/**
+	 * Determine if a message should be logged, so that at most one
+	 * message is logged during each interval (starting with the first
+	 * message).
+	 *
+	 * @param[in] interval_ms Minimum interval between messages in
+	 *                        milliseconds.
+	 * @return True if the message should be logged, otherwise false.
+	 * @since 4.0.0
+	 */
+	bool interval(uint32_t interval_ms);
+
+private:
+	std::atomic<unsigned long> count_{0}; /*!< Number of messages (or logged messages when using an interval). @since 4.0.0 */
+	std::atomic<uint32_t> last_ms_{0}; /*!< Time of the last logged message when using an interval (lower 32 bits of the system uptime). @since 4.0.0 */
+};
+
+/**
+ * Basic log handler for writing messages to any object supporting the
+ * Print interface.
+ *
+ * Outputs all queued messages by default, which may result in the
+ * application blocking until writes complete if the Print destination
+ * buffer is full.
+ *
+ * @since 2.2.0
+ */
+class PrintHandler: public uuid::log::Handler {
+public:
+	static constexpr size_t MAX_LOG_MESSAGES = 50; /*!< Maximum number of log messages to buffer before they are output. @since 2.2.0 */
+	static constexpr uint64_t REPEATED_MESSAGES_INTERVAL_MS = 30000; /*!< Maximum time to wait before outputting the number of repeated log messages. @since 4.0.0 */
+
+	/**
+	 * Create a new Print log handler.
+	 *
+	 * @param[in] print Destination for output of log messages.
+	 * @since 2.2.0
+	 */
+	explicit PrintHandler(Print &print);
+	/**
+	 * Create a new Print log handler, optionally using a lock-free
+	 * queue.
+	 *
+	 * Adding a message to a lock-free queue never waits for loop() to
+	 * output messages, so it can be used from multiple tasks or cores
+	 * without contention. The maximum number of queued log messages is
+	 * rounded up to a power of 2.
+	 *
+	 * @param[in] print Destination for output of log messages.
+	 * @param[in] lock_free Use a lock-free queue for log messages.
+	 * @since 4.0.0
+	 */
+	PrintHandler(Print &print, bool lock_free);
+	~PrintHandler() override;
+
+	/**
+	 * Get the maximum number of queued log messages.
+	 *
+	 * This is the actual capacity of the queue, which is rounded up to
+	 * a power of 2 when using a lock-free queue.
+	 *
+	 * @return The maximum number of queued log messages.
+	 * @since 2.2.0
+	 */
+	size_t maximum_log_messages() const;
+	/**
+	 * Set the maximum number of queued log messages.
+	 *
+	 * Defaults to PrintHandler::MAX_LOG_MESSAGES. Rounded up to a power
+	 * of 2 when using a lock-free queue.
+	 *
+	 * @since 2.2.0
+	 */
+	void maximum_log_messages(size_t count);
+
+	/**
+	 * Get the maximum number of bytes to combine from multiple log
+	 * messages into a single write.
+	 *
+	 * @return The maximum number of bytes to combine into a single
+	 *         write (0 if messages are written individually).
+	 * @since 4.0.0
+	 */
+	size_t maximum_write_size() const;
+	/**
+	 * Set the maximum number of bytes to combine from multiple log
+	 * messages into a single write.
+	 *
+	 * This could be the size of a TCP segment or a DMA buffer. A single
+	 * message that is longer than this size is written on its own.
+	 *
+	 * Defaults to 0 (messages are written individually).
+	 *
+	 * @param[in] size Maximum number of bytes to combine into a
+	 *                 single write.
+	 * @since 4.0.0
+	 */
+	void maximum_write_size(size_t size);
+
+	/**
+	 * Determine if consecutive duplicate log messages are suppressed.
+	 *
+	 * @return True if consecutive duplicate log messages are
+	 *         suppressed, otherwise false.
+	 * @since 4.0.0
+	 */
+	bool suppress_duplicates() const;
+	/**
+	 * Set whether consecutive duplicate log messages are suppressed.
+	 *
+	 * Messages with the same logger name, level, facility and text as
+	 * the previous message are counted instead of being queued. A
+	 * message "last message repeated N times" is queued when a
+	 * different message is received or after
+	 * PrintHandler::REPEATED_MESSAGES_INTERVAL_MS.
+	 *
+	 * Defaults to false. Not supported when using a lock-free queue.
+	 *
+	 * @param[in] enabled Suppress consecutive duplicate log messages.
+	 * @since 4.0.0
+	 */
+	void suppress_duplicates(bool enabled);
+
+	/**
+	 * Dispatch queued log messages.
+	 *
+	 * @param[in] count Maximum number of messages to output.
+	 * @since 2.2.0
+	 */
+	void loop(size_t count = SIZE_MAX);
+
+	/**
+	 * Add a new log message.
+	 *
+	 * This will be put in a queue for output at the next loop()
+	 * process. The queue has a maximum size of
+	 * get_maximum_log_messages() and will discard the oldest message
+	 * first.
+	 *
+	 * @param[in] message New log message, shared by all handlers.
+	 * @since 2.2.0
+	 */
+	void operator<<(std::shared_ptr<Message> message) override;
+
+private:
+	/**
+	 * Bounded lock-free queue of log messages.
+	 *
+	 * @since 4.0.0
+	 */
+	class LockFreeQueue;
+
+	/**
+	 * Add a log message to the queue, discarding the oldest message if
+	 * the queue is full.
+	 *
+	 * @param[in] message New log message.
+	 * @since 4.0.0
+	 */
+	void enqueue(std::shared_ptr<Message> message);
+
+	/**
+	 * Add a log message with the number of times the last message was
+	 * repeated to the queue, if it has been repeated.
+	 *
+	 * @since 4.0.0
+	 */
+	void enqueue_repeated();
+
+	/**
+	 * Determine if two log messages are duplicates.
+	 *
+	 * @param[in] message1 First log message.
+	 * @param[in] message2 Second log message.
+	 * @return True if the messages have the same logger name, level,
+	 *         facility and text, otherwise false.
+	 * @since 4.0.0
+	 */
+	static bool duplicate(const Message &message1, const Message &message2);
+
+	/**
+	 * Remove the next queued log message.
+	 *
+	 * @param[out] message Log message.
+	 * @return True if there was a queued log message, otherwise false.
+	 * @since 4.0.0
+	 */
+	bool next_message(std::shared_ptr<Message> &message);
+
+	/**
+	 * Append a log message to the output buffer.
+	 *
+	 * @param[in] message Log message.
+	 * @since 4.0.0
+	 */
+	void append(const Message &message);
+
+	/**
+	 * Write the start of the output buffer to the destination and
+	 * remove it from the buffer.
+	 *
+	 * @param[in] length Number of bytes to write.
+	 * @since 4.0.0
+	 */
+	void write(size_t length);
+
+	Print &print_; /*!< Destination for output of log messages. @since 2.2.0 */
+#if UUID_LOG_THREAD_SAFE
+	mutable std::mutex mutex_; /*!< Mutex for configuration, state and queued log messages (or the consumer of the lock-free queue). @since 2.3.0 */
+	std::mutex output_mutex_; /*!< Mutex for output of log messages. @since 4.0.0 */
+#endif
+	std::string output_; /*!< Buffer for output of log messages. @since 4.0.0 */
+	TimestampFormatter timestamp_{3}; /*!< Formatter for log message timestamps. @since 4.0.0 */
+	size_t maximum_log_messages_ = MAX_LOG_MESSAGES; /*!< Maximum number of log messages to buffer before they are output. @since 2.2.0 */
+	size_t maximum_write_size_ = 0; /*!< Maximum number of bytes to combine from multiple log messages into a single write. @since 4.0.0 */
+	bool suppress_duplicates_ = false; /*!< Suppress consecutive duplicate log messages. @since 4.0.0 */
+	std::shared_ptr<Message> last_message_; /*!< Last log message that was queued (if suppressing duplicates). @since 4.0.0 */
+	unsigned long repeated_messages_ = 0; /*!< Number of times the last log message has been repeated. @since 4.0.0 */
+	uint64_t repeated_start_ms_ = 0; /*!< Time of the first repeat of the last log message. @since 4.0.0 */
+	uint64_t repeated_last_ms_ = 0; /*!< Time of the most recent repeat of the last log message. @since 4.0.0 */
+	std::unique_ptr<std::shared_ptr<Message>[]> log_messages_; /*!< Circular buffer of queued log messages, in the order they were received (allocated when the first message is added). @since 2.2.0 */
+	size_t log_messages_head_ = 0; /*!< Position of the oldest queued log message. @since 4.0.0 */
+	size_t log_messages_count_ = 0; /*!< Number of queued log messages. @since 4.0.0 */
+	const bool lock_free_; /*!< Use a lock-free queue for log messages. @since 4.0.0 */
+	std::unique_ptr<LockFreeQueue> lock_free_queue_; /*!< Lock-free queue of log messages (if enabled), only used by producers while it's not being replaced. @since 4.0.0 */
+	std::atomic<size_t> producers_{0}; /*!< Number of producers using the lock-free queue. @since 4.0.0 */
+	std::atomic<bool> resizing_{false}; /*!< Lock-free queue is being replaced. @since 4.0.0 */
+};
+
+#if UUID_LOG_THREAD_SAFE
+/**
+ * Log handler for writing messages to any object supporting the Print
+ * interface from a background thread.
+ *
+ * Messages are queued in the same way as a PrintHandler and written in
+ * batches by a writer thread, so the application does not need to call
+ * loop(). A batch is written when the number of queued messages or
+ * bytes of message text reaches a limit, or when the oldest queued
+ * message has waited for the flush interval, whichever comes first.
+ *
+ * The flush limits should be lower than the maximum number of queued
+ * log messages, otherwise messages will be discarded before they are
+ * written.
+ *
+ * Messages with deferred formatting are not counted towards the byte
+ * limit, so that they are formatted by the writer thread.
+ *
+ * Only available when thread safety is available (e.g. on the native
+ * platform and on ESP32).
+ *
+ * @since 4.0.0
+ */
+class AsyncPrintHandler: public PrintHandler {
+public:
+	static constexpr size_t DEFAULT_FLUSH_MESSAGES = 16; /*!< Default number of queued log messages to write in a batch. @since 4.0.0 */
+	static constexpr size_t DEFAULT_FLUSH_BYTES = 1024; /*!< Default number of bytes of queued message text to write in a batch. @since 4.0.0 */
+	static constexpr uint32_t DEFAULT_FLUSH_INTERVAL_MS = 100; /*!< Default maximum time to wait before writing queued log messages. @since 4.0.0 */
+
+	/**
+	 * Create a new background writer log handler and start its writer
+	 * thread.
+	 *
+	 * @param[in] print Destination for output of log messages.
+	 * @since 4.0.0
+	 */
+	explicit AsyncPrintHandler(Print &print);
+	/**
+	 * Create a new background writer log handler, optionally using a
+	 * lock-free queue, and start its writer thread.
+	 *
+	 * @param[in] print Destination for output of log messages.
+	 * @param[in] lock_free Use a lock-free queue for log messages.
+	 * @since 4.0.0
+	 */
+	AsyncPrintHandler(Print &print, bool lock_free);
+	/**
+	 * Stop the writer thread after it has written all queued log
+	 * messages.
+	 *
+	 * @since 4.0.0
+	 */
+	~AsyncPrintHandler() override;
+
+	/**
+	 * Get the number of queued log messages that are written in a
+	 * batch.
+	 *
+	 * @return The number of queued log messages that causes them to be
+	 *         written.
+	 * @since 4.0.0
+	 */
+	size_t flush_messages() const;
+	/**
+	 * Set the number of queued log messages that are written in a
+	 * batch.
+	 *
+	 * Defaults to AsyncPrintHandler::DEFAULT_FLUSH_MESSAGES.
+	 *
+	 * @param[in] count Number of queued log messages that causes them
+	 *                  to be written.
+	 * @since 4.0.0
+	 */
+	void flush_messages(size_t count);
+
+	/**
+	 * Get the number of bytes of queued message text that are written
+	 * in a batch.
+	 *
+	 * @return The number of bytes of queued message text that causes
+	 *         them to be written.
+	 * @since 4.0.0
+	 */
+	size_t flush_bytes() const;
+	/**
+	 * Set the number of bytes of queued message text that are written
+	 * in a batch.
+	 *
+	 * Defaults to AsyncPrintHandler::DEFAULT_FLUSH_BYTES.
+	 *
+	 * @param[in] size Number of bytes of queued message text that
+	 *                 causes them to be written.
+	 * @since 4.0.0
+	 */
+	void flush_bytes(size_t size);
+
+	/**
+	 * Get the maximum time to wait before writing queued log messages.
+	 *
+	 * @return The maximum time to wait in milliseconds.
+	 * @since 4.0.0
+	 */
+	uint32_t flush_interval_ms() const;
+	/**
+	 * Set the maximum time to wait before writing queued log messages.
+	 *
+	 * Defaults to AsyncPrintHandler::DEFAULT_FLUSH_INTERVAL_MS.
+	 *
+	 * @param[in] interval_ms Maximum time to wait in milliseconds.
+	 * @since 4.0.0
+	 */
+	void flush_interval_ms(uint32_t interval_ms);
+
+	/**
+	 * Add a new log message.
+	 *
+	 * This will be put in a queue for output by the writer thread. The
+	 * writer thread is only woken up for the first message of a batch
+	 * and when a flush limit is reached.
+	 *
+	 * @param[in] message New log message, shared by all handlers.
+	 * @since 4.0.0
+	 */
+	void operator<<(std::shared_ptr<Message> message) override;
+
+private:
+	/**
+	 * Write queued log messages in batches until the handler is
+	 * destroyed.
+	 *
+	 * @since 4.0.0
+	 */
+	void run();
+
+	/**
+	 * Determine if a flush limit has been reached.
+	 *
+	 * @return True if the queued log messages should be written,
+	 *         otherwise false.
+	 * @since 4.0.0
+	 */
+	bool flush_required() const;
+
+	/**
+	 * Wake up the writer thread.
+	 *
+	 * @since 4.0.0
+	 */
+	void notify();
+
+	std::atomic<size_t> flush_messages_{DEFAULT_FLUSH_MESSAGES}; /*!< Number of queued log messages that causes them to be written. @since 4.0.0 */
+	std::atomic<size_t> flush_bytes_{DEFAULT_FLUSH_BYTES}; /*!< Number of bytes of queued message text that causes them to be written. @since 4.0.0 */
+	std::atomic<uint32_t> flush_interval_ms_{DEFAULT_FLUSH_INTERVAL_MS}; /*!< Maximum time to wait before writing queued log messages. @since 4.0.0 */
+	std::atomic<size_t> pending_messages_{0}; /*!< Number of log messages queued since the last batch. @since 4.0.0 */
+	std::atomic<size_t> pending_bytes_{0}; /*!< Bytes of message text queued since the last batch. @since 4.0.0 */
+	std::mutex writer_mutex_; /*!< Mutex for waking up the writer thread. @since 4.0.0 */
+	std::condition_variable writer_cv_; /*!< Condition for waking up the writer thread. @since 4.0.0 */
+	bool stop_ = false; /*!< Writer thread should stop. @since 4.0.0 */
+	std::thread writer_; /*!< Writer thread. @since 4.0.0 */
+};
+#endif
+
+/**
+ * Log handler for writing messages to any object supporting the Print
+ * interface as compact binary records.
+ *
+ * Each message is encoded as a record containing a level and facility
+ * byte, the time since the previous message, a numeric identifier for
+ * the logger name and the text. The name of each logger is written
+ * once in a separate record before its first message. Use a
+ * BinaryDecoder to convert the records back into log messages.
+ *
+ * Messages are encoded when they are received and the records are
+ * buffered until they are output by loop().
+ *
+ * @since 4.0.0
+ */
+class BinaryHandler: public uuid::log::Handler {
+public:
+	static constexpr size_t MAX_BUFFER_SIZE = 1024; /*!< Maximum number of bytes of records to buffer before they are output. @since 4.0.0 */
+	static constexpr size_t MAX_NAME_LENGTH = 255; /*!< Maximum length of a logger name in a record. @since 4.0.0 */
+	static constexpr uint8_t NAME_RECORD = 0xFF; /*!< First byte of a record containing a logger name. @since 4.0.0 */
+
+	/**
+	 * Create a new binary log handler.
+	 *
+	 * @param[in] print Destination for output of binary records.
+	 * @since 4.0.0
+	 */
+	explicit BinaryHandler(Print &print);
+	~BinaryHandler() override;
+
+	/**
+	 * Get the maximum number of bytes of buffered records.
+	 *
+	 * @return The maximum number of bytes of buffered records.
+	 * @since 4.0.0
+	 */
+	size_t maximum_buffer_size() const;
+	/**
+	 * Set the maximum number of bytes of buffered records.
+	 *
+	 * Defaults to BinaryHandler::MAX_BUFFER_SIZE.
+	 *
+	 * @param[in] size Maximum number of bytes of buffered records.
+	 * @since 4.0.0
+	 */
+	void maximum_buffer_size(size_t size);
+
+	/**
+	 * Get the number of messages that have been discarded because the
+	 * buffer was full.
+	 *
+	 * @return The number of discarded messages.
+	 * @since 4.0.0
+	 */
+	unsigned long dropped_messages() const;
+
+	/**
+	 * Start a new stream of records, so that all logger names and the
+	 * full time of the next message are written again.
+	 *
+	 * Use this when the destination has changed (e.g. a new file or
+	 * network connection). Buffered records are discarded.
+	 *
+	 * @since 4.0.0
 	 */
-	void vlog(Level level, const __FlashStringHelper *format, va_list ap) const;
+	void reset();
 
 	/**
-	 * Log a message at the specified level and facility.
+	 * Output buffered records.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] format Format string.
-	 * @param[in] ap Variable arguments pointer for format string.
-	 * @since 3.1.0
+	 * @since 4.0.0
 	 */
-	void vlog(Level level, Facility facility, const char *format, va_list ap) const;
+	void loop();
+
 	/**
-	 * Log a message at the specified level and facility.
+	 * Add a new log message.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ap Variable arguments pointer for format string.
-	 * @since 3.1.0
+	 * This will be encoded and buffered for output at the next loop()
+	 * process. The message is discarded if the buffer is full.
+	 *
+	 * @param[in] message New log message, shared by all handlers.
+	 * @since 4.0.0
 	 */
-	void vlog(Level level, Facility facility, const __FlashStringHelper *format, va_list ap) const;
+	void operator<<(std::shared_ptr<Message> message) override;
 
+private:
 	/**
-	 * Log a plain message (without formatting) at the specified level.
+	 * Get the identifier for a logger name, appending a record with
+	 * the name to the buffer if it does not have one yet.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] text Text for the message.
-	 * @since 3.1.0
+	 * @param[in] name Logger name (flash string).
+	 * @return Identifier for the logger name.
+	 * @since 4.0.0
 	 */
-	void logp(Level level, const char *text) const;
+	size_t name_id(const __FlashStringHelper *name);
+
+	Print &print_; /*!< Destination for output of binary records. @since 4.0.0 */
+#if UUID_LOG_THREAD_SAFE
+	mutable std::mutex mutex_; /*!< Mutex for configuration, state and buffered records. @since 4.0.0 */
+	std::mutex output_mutex_; /*!< Mutex for output of binary records. @since 4.0.0 */
+#endif
+	std::string buffer_; /*!< Buffered records. @since 4.0.0 */
+	std::string output_; /*!< Records being output. @since 4.0.0 */
+	size_t maximum_buffer_size_ = MAX_BUFFER_SIZE; /*!< Maximum number of bytes of buffered records. @since 4.0.0 */
+	unsigned long dropped_messages_ = 0; /*!< Number of messages discarded because the buffer was full. @since 4.0.0 */
+	uint64_t last_uptime_ms_ = 0; /*!< Time of the previous message. @since 4.0.0 */
+	std::vector<const __FlashStringHelper *> names_; /*!< Logger names that have been written, indexed by their identifier. @since 4.0.0 */
+};
+
+/**
+ * Decoder for the binary records written by BinaryHandler.
+ *
+ * Records are converted back into log messages and passed to a
+ * handler (e.g. a PrintHandler to output them as text). Records can be
+ * split across multiple calls to decode().
+ *
+ * The logger names of decoded messages are owned by the decoder, so it
+ * must not be destroyed or reset while the handler may still be using
+ * them.
+ *
+ * @since 4.0.0
+ */
+class BinaryDecoder {
+public:
 	/**
-	 * Log an plain message (without formatting) at the specified level and
-	 * facility.
+	 * Create a new binary record decoder.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] text Text for the message.
-	 * @since 3.1.0
+	 * @param[in] handler Handler for decoded log messages.
+	 * @since 4.0.0
 	 */
-	void logp(Level level, Facility facility, const char *text) const;
+	explicit BinaryDecoder(Handler &handler);
+
+	/**
+	 * Decode binary records.
+	 *
+	 * Complete records are passed to the handler and incomplete
+	 * records are kept until the rest of the record is available.
+	 *
+	 * @param[in] data Binary records.
+	 * @param[in] length Length of the binary records.
+	 * @return True if the records are valid, otherwise false (and the
+	 *         remaining data is discarded).
+	 * @since 4.0.0
+	 */
+	bool decode(const uint8_t *data, size_t length);
+
+	/**
+	 * Get the number of decoded messages that were discarded because
+	 * they could not be allocated (see MessagePool::Policy::DROP).
+	 *
+	 * @return The number of discarded messages.
+	 * @since 4.0.0
+	 */
+	unsigned long dropped_messages() const;
+
+	/**
+	 * Start decoding a new stream of records.
+	 *
+	 * @since 4.0.0
+	 */
+	void reset();
 
 private:
 	/**
-	 * Log a message at the specified level and facility without checking that
-	 * the specified level is enabled.
+	 * Decode one complete record from the start of the pending data.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] format Format string.
-	 * @param[in] ap Variable arguments pointer for format string.
-	 * @since 3.1.0
+	 * @param[in,out] pos Position of the record, updated to the
+	 *                    position of the next record.
+	 * @param[out] valid False if the record is invalid.
+	 * @return True if a complete record was decoded, otherwise false.
+	 * @since 4.0.0
 	 */
-	void vlog_internal(Level level, Facility facility, const char *format, va_list ap) const;
+	bool decode_record(size_t &pos, bool &valid);
+
+	Handler &handler_; /*!< Handler for decoded log messages. @since 4.0.0 */
+	std::string pending_; /*!< Data of an incomplete record. @since 4.0.0 */
+	uint64_t uptime_ms_ = 0; /*!< Time of the previous message. @since 4.0.0 */
+	std::vector<std::unique_ptr<char[]>> names_; /*!< Storage for all logger names that have been decoded. @since 4.0.0 */
+	std::vector<const char *> ids_; /*!< Logger names in the current stream, indexed by their identifier. @since 4.0.0 */
+	unsigned long dropped_messages_ = 0; /*!< Number of decoded messages that were discarded. @since 4.0.0 */
+};
+
+#if UUID_LOG_MAPPED_RING_AVAILABLE
+/**
+ * Log handler for writing messages to a ring of records in a
+ * memory-mapped file (Linux only).
+ *
+ * Each message is copied into the next record in the file without any
+ * system calls. Records have a sequence number and a checksum so that
+ * the most recent messages can be recovered by a MappedRingReader
+ * after the application crashes or restarts, even if a record was only
+ * partially written. The oldest records are overwritten when the file
+ * is full.
+ *
+ * @since 4.0.0
+ */
+class MappedRingHandler: public uuid::log::Handler {
+public:
+	static constexpr size_t MIN_FILE_SIZE = 4096; /*!< Minimum size of the file. @since 4.0.0 */
+
+	MappedRingHandler() = default;
+	~MappedRingHandler() override;
+
 	/**
-	 * Log a message at the specified level and facility without checking that
-	 * the specified level is enabled.
+	 * Open a file for log messages, creating it if it does not exist.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] format Format string (flash string).
-	 * @param[in] ap Variable arguments pointer for format string.
-	 * @since 3.1.0
+	 * Existing records are kept if the file already has the same size,
+	 * and new records are written after the most recent one.
+	 *
+	 * @param[in] filename Name of the file.
+	 * @param[in] size Size of the file (at least
+	 *                 MappedRingHandler::MIN_FILE_SIZE).
+	 * @return True if the file was opened, otherwise false.
+	 * @since 4.0.0
 	 */
-	void vlog_internal(Level level, Facility facility, const __FlashStringHelper *format, va_list ap) const;
+	bool open(const char *filename, size_t size);
 
 	/**
-	 * Refresh the minimum global log level across all handlers.
+	 * Close the file. Log messages are discarded until a file is
+	 * opened.
 	 *
-	 * @since 1.0.0
+	 * @since 4.0.0
 	 */
-	static void refresh_log_level();
+	void close();
+
 	/**
-	 * Get registered log handlers.
+	 * Determine if a file is open.
 	 *
-	 * @return The registered log handlers.
-	 * @since 2.1.2
+	 * @return True if a file is open, otherwise false.
+	 * @since 4.0.0
 	 */
-	static std::shared_ptr<std::map<Handler*,Level>>& registered_handlers();
+	bool is_open() const;
 
 	/**
-	 * Dispatch a log message to all handlers that are registered to
-	 * handle messages of the specified level.
+	 * Write modified records to storage so that they are not lost if
+	 * the system crashes (not needed if only the application crashes).
 	 *
-	 * Automatically sets the timestamp of the message to the current
-	 * system uptime.
+	 * @since 4.0.0
+	 */
+	void sync();
+
+	/**
+	 * Add a new log message.
 	 *
-	 * @param[in] level Severity level of the message.
-	 * @param[in] facility Facility type of the process logging the message.
-	 * @param[in] text Log message text.
-	 * @since 1.0.0
+	 * This will be written to the file immediately.
+	 *
+	 * @param[in] message New log message, shared by all handlers.
+	 * @since 4.0.0
 	 */
-	void dispatch(Level level, Facility facility, std::vector<char> &text) const;
+	void operator<<(std::shared_ptr<Message> message) override;
 
+private:
 	/**
-	 * Dispatch a log message to all handlers that are registered to
-	 * handle messages of the specified level.
+	 * Close the file.
 	 *
-	 * @param[in] message Log message.
-	 * @since 3.1.0
+	 * @since 4.0.0
 	 */
-	void dispatch(const std::shared_ptr<Message> &message) const;
+	void close_locked();
 
-	static std::atomic<Level> global_level_; /*!< Minimum global log level across all handlers. @since 3.0.0 */
 #if UUID_LOG_THREAD_SAFE
-	static std::mutex mutex_; /*!< Mutex for handlers. @since 2.3.0 */
+	mutable std::mutex mutex_; /*!< Mutex for the file and records. @since 4.0.0 */
 #endif
+	uint8_t *data_ = nullptr; /*!< Memory-mapped file (if open). @since 4.0.0 */
+	size_t size_ = 0; /*!< Size of the file. @since 4.0.0 */
+	size_t position_ = 0; /*!< Position of the next record. @since 4.0.0 */
+	uint64_t sequence_ = 0; /*!< Sequence number of the next record. @since 4.0.0 */
+};
 
-	const __FlashStringHelper *name_; /*!< Logger name (flash string). @since 1.0.0 */
-	const Facility facility_; /*!< Default logging facility for messages. @since 1.0.0 */
-	Level local_level_{Level::ALL}; /*!< Logger level. @since 3.0.0 */
+/**
+ * Reader for recovering log messages from the file written by a
+ * MappedRingHandler (Linux only).
+ *
+ * The logger names of recovered messages are owned by the reader, so it
+ * must not be destroyed or reopened while a handler may still be using
+ * them.
+ *
+ * @since 4.0.0
+ */
+class MappedRingReader {
+public:
+	MappedRingReader() = default;
+
+	/**
+	 * Open and read a file written by a MappedRingHandler.
+	 *
+	 * @param[in] filename Name of the file.
+	 * @return True if the file was read, otherwise false.
+	 * @since 4.0.0
+	 */
+	bool open(const char *filename);
+
+	/**
+	 * Get the number of valid records in the file.
+	 *
+	 * @return The number of valid records.
+	 * @since 4.0.0
+	 */
+	inline size_t size() const { return records_.size(); }
+
+	/**
+	 * Pass the most recent log messages to a handler, oldest first.
+	 *
+	 * @param[in] handler Handler for the recovered log messages (e.g. a
+	 *                    PrintHandler to output them as text).
+	 * @param[in] count Maximum number of messages to recover.
+	 * @return The number of messages passed to the handler, which
+	 *         excludes any that could not be allocated (see
+	 *         MessagePool::Policy::DROP).
+	 * @since 4.0.0
+	 */
+	size_t read(Handler &handler, size_t count = SIZE_MAX);
+
+private:
+	std::string data_; /*!< Contents of the file. @since 4.0.0 */
+	std::vector<size_t> records_; /*!< Positions of valid records, in sequence order. @since 4.0.0 */
+	std::vector<std::unique_ptr<char[]>> names_; /*!< Storage for logger names of recovered messages. @since 4.0.0 */
 };
+#endif
 
+#if UUID_LOG_SYSLOG_AVAILABLE
 /**
- * Basic log handler for writing messages to any object supporting the
- * Print interface.
+ * Log handler for sending messages to a syslog server (Linux and
+ * ESP-IDF sockets only).
  *
- * Outputs all queued messages by default, which may result in the
- * application blocking until writes complete if the Print destination
- * buffer is full.
+ * Messages are framed as RFC 5424 or RFC 3164 syslog messages directly
+ * into a buffer that is reused for every message. They are sent as
+ * one UDP datagram per message, or in batches over TCP using octet
+ * counting (RFC 6587).
  *
- * @since 2.2.0
+ * The PRI of each message is calculated from its facility and level
+ * (Level::TRACE is sent as debug). The logger name is used as the
+ * MSGID (RFC 5424) or TAG (RFC 3164). Timestamps are only sent if the
+ * system clock has been set.
+ *
+ * Messages are queued until they are sent by loop().
+ *
+ * @since 4.0.0
  */
-class PrintHandler: public uuid::log::Handler {
+class SyslogHandler: public uuid::log::Handler {
 public:
-	static constexpr size_t MAX_LOG_MESSAGES = 50; /*!< Maximum number of log messages to buffer before they are output. @since 2.2.0 */
+	/**
+	 * Format of syslog messages.
+	 *
+	 * @since 4.0.0
+	 */
+	enum Format : uint8_t {
+		RFC5424 = 0, /*!< The Syslog Protocol. @since 4.0.0 */
+		RFC3164, /*!< The BSD syslog Protocol. @since 4.0.0 */
+	};
 
 	/**
-	 * Create a new Print log handler.
+	 * Transport protocol for syslog messages.
 	 *
-	 * @param[in] print Destination for output of log messages.
-	 * @since 2.2.0
+	 * @since 4.0.0
 	 */
-	explicit PrintHandler(Print &print);
-	~PrintHandler() = default;
+	enum Transport : uint8_t {
+		UDP = 0, /*!< One message per datagram. @since 4.0.0 */
+		TCP, /*!< Octet counting framing (RFC 6587). @since 4.0.0 */
+	};
+
+	static constexpr size_t MAX_LOG_MESSAGES = 50; /*!< Maximum number of log messages to buffer before they are sent. @since 4.0.0 */
+	static constexpr size_t MAX_MESSAGE_SIZE = 1024; /*!< Maximum size of a syslog message. @since 4.0.0 */
+	static constexpr size_t MAX_WRITE_SIZE = 4096; /*!< Maximum number of bytes to combine from multiple log messages into a single write over TCP. @since 4.0.0 */
+	static constexpr uint16_t DEFAULT_PORT = 514; /*!< Default syslog port. @since 4.0.0 */
+	static constexpr uint64_t RECONNECT_INTERVAL_MS = 5000; /*!< Minimum time between attempts to connect to the syslog server. @since 4.0.0 */
+	static constexpr int CONNECT_TIMEOUT_MS = 1000; /*!< Maximum time to wait for a connection to the syslog server. @since 4.0.0 */
+
+	/**
+	 * Create a new syslog log handler.
+	 *
+	 * @param[in] format Format of syslog messages.
+	 * @since 4.0.0
+	 */
+	explicit SyslogHandler(Format format = Format::RFC5424);
+	~SyslogHandler() override;
+
+	/**
+	 * Set the syslog server to send messages to.
+	 *
+	 * Connects immediately, waiting for up to
+	 * SyslogHandler::CONNECT_TIMEOUT_MS, and reconnects automatically
+	 * from loop() if the connection fails or is lost. Messages can be
+	 * logged while it is connecting.
+	 *
+	 * @param[in] host Host name or address of the syslog server.
+	 * @param[in] port Port of the syslog server.
+	 * @param[in] transport Transport protocol for syslog messages.
+	 * @return True if the host was resolved and the socket is
+	 *         connected, otherwise false (connections will be retried
+	 *         by loop() if the host was resolved).
+	 * @since 4.0.0
+	 */
+	bool destination(const char *host, uint16_t port = DEFAULT_PORT, Transport transport = Transport::UDP);
+
+	/**
+	 * Stop sending messages to the syslog server.
+	 *
+	 * Queued messages are discarded.
+	 *
+	 * @since 4.0.0
+	 */
+	void close();
+
+	/**
+	 * Get the host name of this system that is sent in messages.
+	 *
+	 * @return Host name of this system (empty if not set).
+	 * @since 4.0.0
+	 */
+	std::string hostname() const;
+	/**
+	 * Set the host name of this system that is sent in messages.
+	 *
+	 * @param[in] name Host name of this system (empty if not set).
+	 * @since 4.0.0
+	 */
+	void hostname(std::string name);
+
+	/**
+	 * Get the application name that is sent in messages.
+	 *
+	 * @return Application name (empty if not set).
+	 * @since 4.0.0
+	 */
+	std::string app_name() const;
+	/**
+	 * Set the application name that is sent in messages (RFC 5424
+	 * only).
+	 *
+	 * @param[in] name Application name (empty if not set).
+	 * @since 4.0.0
+	 */
+	void app_name(std::string name);
 
 	/**
 	 * Get the maximum number of queued log messages.
 	 *
 	 * @return The maximum number of queued log messages.
-	 * @since 2.2.0
+	 * @since 4.0.0
 	 */
 	size_t maximum_log_messages() const;
 	/**
 	 * Set the maximum number of queued log messages.
 	 *
-	 * Defaults to PrintHandler::MAX_LOG_MESSAGES.
+	 * Defaults to SyslogHandler::MAX_LOG_MESSAGES.
 	 *
-	 * @since 2.2.0
+	 * @param[in] count Maximum number of queued log messages.
+	 * @since 4.0.0
 	 */
 	void maximum_log_messages(size_t count);
 
 	/**
-	 * Dispatch queued log messages.
+	 * Get the number of messages that have been discarded because the
+	 * queue was full or they could not be sent.
 	 *
-	 * @param[in] count Maximum number of messages to output.
-	 * @since 2.2.0
+	 * @return The number of discarded messages.
+	 * @since 4.0.0
 	 */
-	void loop(size_t count = SIZE_MAX);
+	unsigned long dropped_messages() const;
+
+	/**
+	 * Send queued log messages.
+	 *
+	 * @since 4.0.0
+	 */
+	void loop();
 
 	/**
 	 * Add a new log message.
 	 *
-	 * This will be put in a queue for output at the next loop()
-	 * process. The queue has a maximum size of
-	 * get_maximum_log_messages() and will discard the oldest message
-	 * first.
+	 * This will be put in a queue for sending at the next loop()
+	 * process. New messages are discarded if the queue is full.
 	 *
 	 * @param[in] message New log message, shared by all handlers.
-	 * @since 2.2.0
+	 * @since 4.0.0
 	 */
 	void operator<<(std::shared_ptr<Message> message) override;
 
 private:
-	Print &print_; /*!< Destination for output of log messages. @since 2.2.0 */
+	/**
+	 * Create a socket and connect it to the syslog server.
+	 *
+	 * Only the output mutex needs to be locked, so that messages can
+	 * still be queued while this is waiting for the connection.
+	 *
+	 * @return True if the socket is connected, otherwise false.
+	 * @since 4.0.0
+	 */
+	bool connect();
+
+	/**
+	 * Close the socket.
+	 *
+	 * @since 4.0.0
+	 */
+	void disconnect();
+
+	/**
+	 * Append a syslog message to the output buffer.
+	 *
+	 * @param[in] message Log message.
+	 * @param[in] now_ms Current system uptime.
+	 * @param[in] now_s Current time of the system clock (0 if it has
+	 *                  not been set).
+	 * @param[in] now_ms_part Milliseconds part of the current time of
+	 *                        the system clock.
+	 * @since 4.0.0
+	 */
+	void append(const Message &message, uint64_t now_ms, int64_t now_s, unsigned int now_ms_part);
+
+	/**
+	 * Send the output buffer to the syslog server.
+	 *
+	 * @return True if the output buffer was sent, otherwise false.
+	 * @since 4.0.0
+	 */
+	bool send();
+
+	const Format format_; /*!< Format of syslog messages. @since 4.0.0 */
 #if UUID_LOG_THREAD_SAFE
-	mutable std::mutex mutex_; /*!< Mutex for configuration, state and queued log messages. @since 2.3.0 */
+	mutable std::mutex mutex_; /*!< Mutex for configuration and queued log messages. @since 4.0.0 */
+	std::mutex output_mutex_; /*!< Mutex for the socket and sending log messages. @since 4.0.0 */
 #endif
-	size_t maximum_log_messages_ = MAX_LOG_MESSAGES; /*!< Maximum number of log messages to buffer before they are output. @since 2.2.0 */
-	std::list<std::shared_ptr<Message>> log_messages_; /*!< Queued log messages, in the order they were received. @since 2.2.0 */
+	Transport transport_ = Transport::UDP; /*!< Transport protocol for syslog messages. @since 4.0.0 */
+	std::string address_; /*!< Socket address of the syslog server (empty if not set). @since 4.0.0 */
+	int fd_ = -1; /*!< Socket (or -1 if not connected), protected by the output mutex. @since 4.0.0 */
+	uint64_t connect_ms_ = 0; /*!< Time of the last attempt to connect to the syslog server. @since 4.0.0 */
+	std::string hostname_; /*!< Host name of this system. @since 4.0.0 */
+	std::string app_name_; /*!< Application name. @since 4.0.0 */
+	size_t maximum_log_messages_ = MAX_LOG_MESSAGES; /*!< Maximum number of log messages to buffer before they are sent. @since 4.0.0 */
+	unsigned long dropped_messages_ = 0; /*!< Number of messages discarded. @since 4.0.0 */
+	std::vector<std::shared_ptr<Message>> log_messages_; /*!< Queued log messages. @since 4.0.0 */
+	std::vector<std::shared_ptr<Message>> sending_; /*!< Log messages being sent. @since 4.0.0 */
+	std::string output_; /*!< Buffer for syslog messages. @since 4.0.0 */
 };
+#endif
 
 } // namespace log
 
 } // namespace uuid
 
+/**
+ * Log a message at level Level::EMERG using a Logger, unless the level
+ * is excluded by uuid::log::min_level.
+ *
+ * If the level is excluded then the arguments are not evaluated and
+ * the call is removed at compile time.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_EMERG(logger, ...) UUID_LOG_LEVEL_(logger, EMERG, emerg, __VA_ARGS__)
+/**
+ * Log a message at level Level::ALERT using a Logger, unless the level
+ * is excluded by uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_ALERT(logger, ...) UUID_LOG_LEVEL_(logger, ALERT, alert, __VA_ARGS__)
+/**
+ * Log a message at level Level::CRIT using a Logger, unless the level
+ * is excluded by uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_CRIT(logger, ...) UUID_LOG_LEVEL_(logger, CRIT, crit, __VA_ARGS__)
+/**
+ * Log a message at level Level::ERR using a Logger, unless the level
+ * is excluded by uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_ERR(logger, ...) UUID_LOG_LEVEL_(logger, ERR, err, __VA_ARGS__)
+/**
+ * Log a message at level Level::WARNING using a Logger, unless the
+ * level is excluded by uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_WARNING(logger, ...) UUID_LOG_LEVEL_(logger, WARNING, warning, __VA_ARGS__)
+/**
+ * Log a message at level Level::NOTICE using a Logger, unless the
+ * level is excluded by uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_NOTICE(logger, ...) UUID_LOG_LEVEL_(logger, NOTICE, notice, __VA_ARGS__)
+/**
+ * Log a message at level Level::INFO using a Logger, unless the level
+ * is excluded by uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_INFO(logger, ...) UUID_LOG_LEVEL_(logger, INFO, info, __VA_ARGS__)
+/**
+ * Log a message at level Level::DEBUG using a Logger, unless the level
+ * is excluded by uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_DEBUG(logger, ...) UUID_LOG_LEVEL_(logger, DEBUG, debug, __VA_ARGS__)
+/**
+ * Log a message at level Level::TRACE using a Logger, unless the level
+ * is excluded by uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_TRACE(logger, ...) UUID_LOG_LEVEL_(logger, TRACE, trace, __VA_ARGS__)
+
+/**
+ * Log 1 in N messages from this call site at a level using a Logger,
+ * unless the level is excluded by uuid::log::min_level.
+ *
+ * Messages are only counted if the level is enabled. Messages that are
+ * not logged are not formatted.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] level Name of the log level (e.g. TRACE).
+ * @param[in] n Log 1 in this number of messages.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_EVERY_N(logger, level, n, ...) UUID_LOG_SAMPLE_(logger, level, every(n), __VA_ARGS__)
+/**
+ * Log at most one message from this call site during each interval at a
+ * level using a Logger, unless the level is excluded by
+ * uuid::log::min_level.
+ *
+ * Messages that are not logged are not formatted.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] level Name of the log level (e.g. TRACE).
+ * @param[in] interval_ms Minimum interval between messages in
+ *                        milliseconds.
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_EVERY_MS(logger, level, interval_ms, ...) UUID_LOG_SAMPLE_(logger, level, interval(interval_ms), __VA_ARGS__)
+/**
+ * Log a message at a level using a Logger from a call site that caches
+ * whether it is enabled and can be enabled or disabled at runtime (see
+ * uuid::log::CallSite), unless the level is excluded by
+ * uuid::log::min_level.
+ *
+ * @param[in] logger Logger to use.
+ * @param[in] level Name of the log level (e.g. DEBUG).
+ * @param[in] ... Format string and arguments.
+ * @since 4.0.0
+ */
+#define UUID_LOG_SITE(logger, level, ...) \
+	do { \
+		if (::uuid::log::Level::level <= ::uuid::log::min_level) { \
+			static ::uuid::log::CallSite uuid_log_site_{__FILE__, __LINE__}; \
+			if (uuid_log_site_.enabled((logger), ::uuid::log::Level::level)) { \
+				uuid_log_site_.log((logger), ::uuid::log::Level::level, __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+//! @cond false
+#define UUID_LOG_SAMPLE_(logger, level, sample, ...) \
+	do { \
+		if (::uuid::log::Level::level <= ::uuid::log::min_level \
+				&& (logger).enabled(::uuid::log::Level::level)) { \
+			static ::uuid::log::Sampler uuid_log_sampler_; \
+			if (uuid_log_sampler_.sample) { \
+				(logger).log(::uuid::log::Level::level, __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+#define UUID_LOG_LEVEL_(logger, level, function, ...) \
+	do { \
+		if (::uuid::log::Level::level <= ::uuid::log::min_level) { \
+			(logger).function(__VA_ARGS__); \
+		} \
+	} while (0)
+//! @endcond
+
 #endif
@@ -34,9 +34,11 @@ class __FlashStringHelper;
 #define FPSTR(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
 #define F(string_literal) (FPSTR(PSTR(string_literal)))
 
+#define memcpy_P memcpy
 #define strlen_P strlen
 #define strncpy_P strncpy
 #define strcmp_P strcmp
+#define strncmp_P strncmp
 
 int snprintf_P(char *str, size_t size, const char *format, ...);
 int vsnprintf_P(char *str, size_t size, const char *format, va_list ap);
@@ -32,10 +32,15 @@ class __FlashStringHelper;
 #define FPSTR(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
 #define F(string_literal) (FPSTR(PSTR(string_literal)))
 
+#define memcpy_P memcpy
+#define strlen_P strlen
 #define strcmp_P strcmp
+#define strncmp_P strncmp
 #define snprintf_P snprintf
 #define vsnprintf_P vsnprintf
 
+#define pgm_read_byte(addr) (*reinterpret_cast<const char *>(addr))
+
 class Print;
 
 class Printable {
@@ -0,0 +1,265 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+
+#include <uuid/log.h>
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+	void *ptr = std::malloc(size ? size : 1);
+
+	if (!ptr) {
+		throw std::bad_alloc{};
+	}
+
+	allocations++;
+	return ptr;
+}
+
+void *operator new[](size_t size) {
+	return ::operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t size) noexcept {
+	std::free(ptr);
+}
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		message_ = message;
+	}
+
+	std::shared_ptr<uuid::log::Message> message_;
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static uint64_t millis = 0;
+	return ++millis;
+}
+
+} // namespace uuid
+
+/*
+ * Count the heap allocations made by an enabled log call, excluding the
+ * release of the previous message.
+ */
+template<typename F>
+static size_t count_allocations(Test &test, F log) {
+	test.message_.reset();
+
+	size_t before = allocations;
+	log();
+	return allocations - before;
+}
+
+/*
+ * The Message and its text must be a single allocation. Formatting must
+ * not allocate anything.
+ */
+void test_format() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	TEST_ASSERT_EQUAL_INT(1, count_allocations(test, [&] { logger.info("Hello %u", 42); }));
+	TEST_ASSERT_TRUE(test.message_);
+	TEST_ASSERT_EQUAL_STRING("Hello 42", test.message_->text.c_str());
+
+	TEST_ASSERT_EQUAL_INT(1, count_allocations(test, [&] { logger.info(F("Hello, %u World! This text is too long for the small string buffer"), 42); }));
+	TEST_ASSERT_TRUE(test.message_);
+	TEST_ASSERT_EQUAL_STRING("Hello, 42 World! This text is too long for the small string buffer", test.message_->text.c_str());
+}
+
+/*
+ * Messages longer than the maximum length are truncated without
+ * needing any additional allocations.
+ */
+void test_truncate() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	std::string text(uuid::log::Logger::MAX_LOG_LENGTH * 2, 'x');
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	TEST_ASSERT_EQUAL_INT(1, count_allocations(test, [&] { logger.info("%s", text.c_str()); }));
+	TEST_ASSERT_TRUE(test.message_);
+	TEST_ASSERT_EQUAL_INT(uuid::log::Logger::MAX_LOG_LENGTH, test.message_->text.length());
+}
+
+/*
+ * Plain messages must be a single allocation.
+ */
+void test_plain() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	TEST_ASSERT_EQUAL_INT(1, count_allocations(test, [&] { logger.logp(uuid::log::Level::INFO, "Hello, World! This text is too long for the small string buffer"); }));
+	TEST_ASSERT_TRUE(test.message_);
+	TEST_ASSERT_EQUAL_STRING("Hello, World! This text is too long for the small string buffer", test.message_->text.c_str());
+	TEST_ASSERT_EQUAL_INT(63, test.message_->text.length());
+}
+
+/*
+ * Disabled log calls must not allocate anything.
+ */
+void test_disabled() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+
+	TEST_ASSERT_EQUAL_INT(0, count_allocations(test, [&] { logger.debug("Hello %u", 42); }));
+	TEST_ASSERT_FALSE(test.message_);
+}
+
+/*
+ * Messages allocated from the pool must not use the heap, and the
+ * configured policy must be applied when the pool is exhausted.
+ */
+void test_pool() {
+	using uuid::log::MessagePool;
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	std::shared_ptr<uuid::log::Message> message1;
+	std::shared_ptr<uuid::log::Message> message2;
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	TEST_ASSERT_TRUE(MessagePool::configure(2, MessagePool::Policy::DROP, 32));
+	TEST_ASSERT_EQUAL_INT(2, MessagePool::count());
+	TEST_ASSERT_EQUAL_INT(2, MessagePool::available());
+
+	TEST_ASSERT_EQUAL_INT(0, count_allocations(test, [&] { logger.info("Hello %u", 1); }));
+	message1 = test.message_;
+	TEST_ASSERT_EQUAL_STRING("Hello 1", message1->text.c_str());
+	TEST_ASSERT_EQUAL_INT(0, count_allocations(test, [&] { logger.info("Hello %u", 2); }));
+	message2 = test.message_;
+	TEST_ASSERT_EQUAL_STRING("Hello 2", message2->text.c_str());
+	TEST_ASSERT_EQUAL_INT(0, MessagePool::available());
+
+	TEST_ASSERT_EQUAL_INT(0, count_allocations(test, [&] { logger.info("Hello %u", 3); }));
+	TEST_ASSERT_FALSE(test.message_);
+	TEST_ASSERT_EQUAL_INT(1, MessagePool::dropped_messages());
+
+	TEST_ASSERT_FALSE_MESSAGE(MessagePool::configure(2, MessagePool::Policy::HEAP, 32), "Pool must not be reconfigured while in use");
+
+	message1.reset();
+	TEST_ASSERT_EQUAL_INT(1, MessagePool::available());
+	TEST_ASSERT_EQUAL_INT(0, count_allocations(test, [&] { logger.info("Hello %u", 4); }));
+	TEST_ASSERT_EQUAL_STRING("Hello 4", test.message_->text.c_str());
+	TEST_ASSERT_EQUAL_INT(3, MessagePool::pool_allocations());
+
+	test.message_.reset();
+	message2.reset();
+	TEST_ASSERT_EQUAL_INT(2, MessagePool::available());
+
+	TEST_ASSERT_TRUE(MessagePool::configure(1, MessagePool::Policy::HEAP, 32));
+	TEST_ASSERT_EQUAL_INT(0, count_allocations(test, [&] { logger.info("Hello %u", 5); }));
+	message1 = test.message_;
+	TEST_ASSERT_EQUAL_INT(1, count_allocations(test, [&] { logger.info("Hello %u", 6); }));
+	TEST_ASSERT_EQUAL_STRING("Hello 6", test.message_->text.c_str());
+	TEST_ASSERT_EQUAL_INT(1, MessagePool::heap_allocations());
+
+	message1.reset();
+	TEST_ASSERT_EQUAL_INT(1, count_allocations(test, [&] { logger.info("Hello, %u World! This text is too long for the pool", 7); }));
+	TEST_ASSERT_EQUAL_STRING("Hello, 7 World! This text is too long for the pool", test.message_->text.c_str());
+	TEST_ASSERT_EQUAL_INT(2, MessagePool::heap_allocations());
+	TEST_ASSERT_EQUAL_INT(1, MessagePool::available());
+
+	test.message_.reset();
+	TEST_ASSERT_TRUE(MessagePool::configure(0));
+	TEST_ASSERT_EQUAL_INT(0, MessagePool::count());
+}
+
+/*
+ * Deferred messages allocated from the pool must be formatted into the
+ * rest of their slot if the text fits. Otherwise the formatted text is
+ * a separate allocation.
+ */
+void test_deferred() {
+	using uuid::log::MessagePool;
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	size_t before;
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	TEST_ASSERT_EQUAL_INT(1, count_allocations(test, [&] { logger.logd(uuid::log::Level::INFO, "Hello %u", 1); }));
+	before = allocations;
+	TEST_ASSERT_EQUAL_STRING("Hello 1", test.message_->text.c_str());
+	TEST_ASSERT_EQUAL_INT_MESSAGE(1, allocations - before, "Text of heap messages must be allocated when formatted");
+
+	TEST_ASSERT_TRUE(MessagePool::configure(1, MessagePool::Policy::DROP, 32));
+
+	TEST_ASSERT_EQUAL_INT(0, count_allocations(test, [&] { logger.logd(uuid::log::Level::INFO, "Hello %u", 2); }));
+	before = allocations;
+	TEST_ASSERT_EQUAL_STRING("Hello 2", test.message_->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello 2", std::string(test.message_->text).c_str());
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, allocations - before, "Text of pool messages must be formatted into the slot");
+
+	TEST_ASSERT_EQUAL_INT(0, count_allocations(test, [&] { logger.logd(uuid::log::Level::INFO, "Hello, %u World! This text is too long for the slot", 3); }));
+	before = allocations;
+	TEST_ASSERT_EQUAL_STRING("Hello, 3 World! This text is too long for the slot", test.message_->text.c_str());
+	TEST_ASSERT_EQUAL_INT_MESSAGE(1, allocations - before, "Text that doesn't fit in the slot must be allocated");
+
+	test.message_.reset();
+	TEST_ASSERT_EQUAL_INT(1, MessagePool::available());
+	TEST_ASSERT_TRUE(MessagePool::configure(0));
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_format);
+	RUN_TEST(test_truncate);
+	RUN_TEST(test_plain);
+	RUN_TEST(test_disabled);
+	RUN_TEST(test_pool);
+	RUN_TEST(test_deferred);
+	return UNITY_END();
+}
@@ -0,0 +1,249 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uuid/log.h>
+
+using uuid::log::Message;
+
+class TestPrint: public Print {
+public:
+	TestPrint() = default;
+
+	size_t write(uint8_t c) override {
+		return write(&c, 1);
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+		output_.append(reinterpret_cast<const char *>(buffer), size);
+		writes_++;
+		return size;
+	}
+
+	size_t lines() {
+#if UUID_LOG_THREAD_SAFE
+		std::lock_guard<std::mutex> lock{mutex_};
+#endif
+		size_t count = 0;
+
+		for (size_t pos = 0; (pos = output_.find("\r\n", pos)) != std::string::npos; pos += 2) {
+			count++;
+		}
+		return count;
+	}
+
+#if UUID_LOG_THREAD_SAFE
+	std::mutex mutex_;
+#endif
+	std::string output_;
+	size_t writes_ = 0;
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return 0;
+}
+
+} // namespace uuid
+
+#if UUID_LOG_THREAD_SAFE
+using uuid::log::AsyncPrintHandler;
+
+static std::shared_ptr<Message> create_message(const char *text) {
+	return std::make_shared<Message>(0, uuid::log::Level::INFO,
+		uuid::log::Facility::LOCAL0,
+		reinterpret_cast<const __FlashStringHelper *>("test"), text);
+}
+
+/* Wait for the writer thread to output a number of lines */
+static bool wait_for_lines(TestPrint &print, size_t count) {
+	auto end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+	while (print.lines() < count) {
+		if (std::chrono::steady_clock::now() >= end) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+static void settle() {
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+static void test_flush_messages(bool lock_free) {
+	TestPrint print;
+	AsyncPrintHandler handler{print, lock_free};
+
+	handler.flush_interval_ms(60000);
+	handler.flush_messages(5);
+	TEST_ASSERT_EQUAL_INT(5, handler.flush_messages());
+
+	for (unsigned int i = 0; i < 4; i++) {
+		handler << create_message("Hello");
+	}
+
+	settle();
+	TEST_ASSERT_EQUAL_INT(0, print.lines());
+
+	handler << create_message("World");
+	TEST_ASSERT_TRUE(wait_for_lines(print, 5));
+
+	/* A new batch is started after the previous one */
+	for (unsigned int i = 0; i < 4; i++) {
+		handler << create_message("Hello");
+	}
+
+	settle();
+	TEST_ASSERT_EQUAL_INT(5, print.lines());
+
+	handler << create_message("World");
+	TEST_ASSERT_TRUE(wait_for_lines(print, 10));
+}
+
+/*
+ * Queued messages must be written when the number of messages reaches
+ * the limit.
+ */
+void test_flush_messages_locked() {
+	test_flush_messages(false);
+}
+
+/*
+ * Queued messages must be written when the number of messages reaches
+ * the limit (lock-free queue).
+ */
+void test_flush_messages_lock_free() {
+	test_flush_messages(true);
+}
+
+/*
+ * Queued messages must be written when the number of bytes of text
+ * reaches the limit.
+ */
+void test_flush_bytes() {
+	TestPrint print;
+	AsyncPrintHandler handler{print};
+
+	handler.flush_interval_ms(60000);
+	handler.flush_bytes(100);
+	TEST_ASSERT_EQUAL_INT(100, handler.flush_bytes());
+
+	handler << create_message(std::string(60, 'x').c_str());
+	settle();
+	TEST_ASSERT_EQUAL_INT(0, print.lines());
+
+	handler << create_message(std::string(40, 'x').c_str());
+	TEST_ASSERT_TRUE(wait_for_lines(print, 2));
+}
+
+/*
+ * Queued messages must be written when the oldest message has waited
+ * for the flush interval.
+ */
+void test_flush_interval() {
+	TestPrint print;
+	AsyncPrintHandler handler{print};
+
+	handler.flush_interval_ms(20);
+	TEST_ASSERT_EQUAL_INT(20, handler.flush_interval_ms());
+
+	auto start = std::chrono::steady_clock::now();
+
+	handler << create_message("Hello");
+	handler << create_message("World");
+	TEST_ASSERT_TRUE(wait_for_lines(print, 2));
+	TEST_ASSERT_TRUE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+	TEST_ASSERT_EQUAL_INT(2, print.writes_);
+}
+
+/*
+ * Queued messages must be written when the handler is destroyed.
+ */
+void test_destroy() {
+	TestPrint print;
+
+	{
+		AsyncPrintHandler handler{print};
+		uuid::log::Logger logger{F("test")};
+
+		uuid::log::Logger::register_handler(&handler, uuid::log::Level::ALL);
+		handler.flush_interval_ms(60000);
+
+		logger.info("Hello");
+		logger.info("World");
+	}
+
+	TEST_ASSERT_EQUAL_INT(2, print.lines());
+}
+
+/*
+ * Messages from multiple threads must all be written.
+ */
+void test_threads() {
+	static constexpr unsigned int PRODUCERS = 4;
+	static constexpr unsigned int MESSAGES = 1000;
+	TestPrint print;
+	AsyncPrintHandler handler{print, true};
+	std::vector<std::thread> producers;
+
+	handler.maximum_log_messages(PRODUCERS * MESSAGES);
+	handler.flush_interval_ms(5);
+
+	for (unsigned int i = 0; i < PRODUCERS; i++) {
+		producers.emplace_back([&handler] {
+			for (unsigned int j = 0; j < MESSAGES; j++) {
+				handler << create_message("Hello");
+			}
+		});
+	}
+
+	for (auto &producer : producers) {
+		producer.join();
+	}
+
+	TEST_ASSERT_TRUE(wait_for_lines(print, PRODUCERS * MESSAGES));
+}
+#endif
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+#if UUID_LOG_THREAD_SAFE
+	RUN_TEST(test_flush_messages_locked);
+	RUN_TEST(test_flush_messages_lock_free);
+	RUN_TEST(test_flush_bytes);
+	RUN_TEST(test_flush_interval);
+	RUN_TEST(test_destroy);
+	RUN_TEST(test_threads);
+#endif
+	return UNITY_END();
+}
@@ -95,8 +95,84 @@ void test() {
 	TEST_ASSERT_TRUE_MESSAGE(test1.message_.get() == test2.message_.get(), "Message must be shared between handlers");
 }
 
+void test_levels() {
+	Test test1;
+	Test test2;
+	Test test3;
+
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::get_log_level(&test1));
+
+	uuid::log::Logger::register_handler(&test1, uuid::log::Level::INFO);
+	uuid::log::Logger::register_handler(&test2, uuid::log::Level::DEBUG);
+	uuid::log::Logger::register_handler(&test3, uuid::log::Level::ERR);
+
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::INFO, uuid::log::Logger::get_log_level(&test1));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, uuid::log::Logger::get_log_level(&test2));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::ERR, uuid::log::Logger::get_log_level(&test3));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, uuid::log::Logger::global_level());
+
+	uuid::log::Logger::register_handler(&test3, uuid::log::Level::TRACE);
+
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::TRACE, uuid::log::Logger::get_log_level(&test3));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::TRACE, uuid::log::Logger::global_level());
+
+	uuid::log::Logger::unregister_handler(&test3);
+	uuid::log::Logger::unregister_handler(&test3);
+
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::get_log_level(&test3));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::INFO, uuid::log::Logger::get_log_level(&test1));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, uuid::log::Logger::get_log_level(&test2));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, uuid::log::Logger::global_level());
+
+	uuid::log::Logger::unregister_handler(&test2);
+	uuid::log::Logger::unregister_handler(&test1);
+
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::global_level());
+}
+
+void test_dispatch() {
+	Test console;
+	Test syslog;
+	Test capture;
+	Test disabled;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&console, uuid::log::Level::INFO);
+	uuid::log::Logger::register_handler(&syslog, uuid::log::Level::NOTICE);
+	uuid::log::Logger::register_handler(&capture, uuid::log::Level::TRACE);
+	uuid::log::Logger::register_handler(&disabled, uuid::log::Level::OFF);
+
+	logger.trace("Hello, %u World!", 1);
+	TEST_ASSERT_FALSE_MESSAGE(console.message_, "Console handler must not have the message");
+	TEST_ASSERT_FALSE_MESSAGE(syslog.message_, "Syslog handler must not have the message");
+	TEST_ASSERT_TRUE_MESSAGE(capture.message_, "Capture handler must have the message");
+	TEST_ASSERT_FALSE_MESSAGE(disabled.message_, "Disabled handler must not have the message");
+	TEST_ASSERT_EQUAL_STRING("Hello, 1 World!", capture.message_->text.c_str());
+
+	logger.info("Hello, %u World!", 2);
+	TEST_ASSERT_TRUE_MESSAGE(console.message_, "Console handler must have the message");
+	TEST_ASSERT_FALSE_MESSAGE(syslog.message_, "Syslog handler must not have the message");
+	TEST_ASSERT_EQUAL_STRING("Hello, 2 World!", console.message_->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello, 2 World!", capture.message_->text.c_str());
+
+	logger.notice("Hello, %u World!", 3);
+	TEST_ASSERT_TRUE_MESSAGE(syslog.message_, "Syslog handler must have the message");
+	TEST_ASSERT_EQUAL_STRING("Hello, 3 World!", console.message_->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello, 3 World!", syslog.message_->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello, 3 World!", capture.message_->text.c_str());
+	TEST_ASSERT_FALSE_MESSAGE(disabled.message_, "Disabled handler must not have the message");
+
+	uuid::log::Logger::register_handler(&capture, uuid::log::Level::WARNING);
+
+	logger.notice("Hello, %u World!", 4);
+	TEST_ASSERT_EQUAL_STRING("Hello, 4 World!", syslog.message_->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello, 3 World!", capture.message_->text.c_str());
+}
+
 int main(int argc, char *argv[]) {
 	UNITY_BEGIN();
 	RUN_TEST(test);
+	RUN_TEST(test_levels);
+	RUN_TEST(test_dispatch);
 	return UNITY_END();
 }
@@ -0,0 +1,283 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <uuid/log.h>
+
+using ::uuid::log::BinaryDecoder;
+using ::uuid::log::BinaryHandler;
+using ::uuid::log::Facility;
+using ::uuid::log::Level;
+using ::uuid::log::Message;
+using ::uuid::log::PrintHandler;
+
+class TestPrint: public Print {
+public:
+	TestPrint() = default;
+
+	size_t write(uint8_t c) override {
+		return write(&c, 1);
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		output_.append(reinterpret_cast<const char *>(buffer), size);
+		return size;
+	}
+
+	std::string output_;
+};
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<Message> message) override {
+		messages_.push_back(message);
+	}
+
+	std::vector<std::shared_ptr<Message>> messages_;
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return 0;
+}
+
+} // namespace uuid
+
+static std::shared_ptr<Message> create_message(uint64_t uptime_ms, Level level,
+		Facility facility, const char *name, const char *text) {
+	return std::make_shared<Message>(uptime_ms, level, facility,
+		reinterpret_cast<const __FlashStringHelper *>(name), text);
+}
+
+static std::vector<std::shared_ptr<Message>> sample_messages() {
+	static const char *wifi = "wifi";
+	static const char *mqtt = "mqtt";
+
+	return {
+		create_message(1234, Level::INFO, Facility::DAEMON, wifi, "Connected to network"),
+		create_message(1240, Level::DEBUG, Facility::LOCAL0, mqtt, "Connecting to broker"),
+		create_message(1500, Level::NOTICE, Facility::LOCAL0, mqtt, "Connected"),
+		create_message(1499, Level::TRACE, Facility::LOCAL7, wifi, "RSSI -67"),
+		create_message(86400000 + 3723004, Level::EMERG, Facility::KERN, wifi, ""),
+		create_message(86400000 + 3723005, Level::WARNING, Facility::LOCAL0, mqtt, "Disconnected"),
+	};
+}
+
+/*
+ * Decoded messages must be the same as the original messages.
+ */
+void test_round_trip() {
+	TestPrint print;
+	BinaryHandler handler{print};
+	Test test;
+	BinaryDecoder decoder{test};
+	auto messages = sample_messages();
+
+	for (auto &message : messages) {
+		handler << message;
+	}
+
+	handler.loop();
+	TEST_ASSERT_TRUE(decoder.decode(reinterpret_cast<const uint8_t *>(print.output_.data()), print.output_.size()));
+	TEST_ASSERT_EQUAL_INT(messages.size(), test.messages_.size());
+
+	for (size_t i = 0; i < messages.size(); i++) {
+		TEST_ASSERT_EQUAL_UINT64(messages[i]->uptime_ms, test.messages_[i]->uptime_ms);
+		TEST_ASSERT_EQUAL_INT(messages[i]->level, test.messages_[i]->level);
+		TEST_ASSERT_EQUAL_INT(messages[i]->facility, test.messages_[i]->facility);
+		TEST_ASSERT_EQUAL_STRING(reinterpret_cast<const char *>(messages[i]->name),
+			reinterpret_cast<const char *>(test.messages_[i]->name));
+		TEST_ASSERT_EQUAL_STRING(messages[i]->text.c_str(), test.messages_[i]->text.c_str());
+	}
+}
+
+/*
+ * Records must be decoded when they are split at any position.
+ */
+void test_split() {
+	TestPrint print;
+	BinaryHandler handler{print};
+	auto messages = sample_messages();
+
+	for (auto &message : messages) {
+		handler << message;
+	}
+	handler.loop();
+
+	for (size_t split = 0; split <= print.output_.size(); split++) {
+		Test test;
+		BinaryDecoder decoder{test};
+		const uint8_t *data = reinterpret_cast<const uint8_t *>(print.output_.data());
+
+		for (size_t pos = 0; pos < print.output_.size(); pos += split ? split : 1) {
+			size_t length = std::min(split ? split : 1, print.output_.size() - pos);
+
+			TEST_ASSERT_TRUE(decoder.decode(&data[pos], length));
+		}
+
+		TEST_ASSERT_EQUAL_INT(messages.size(), test.messages_.size());
+		TEST_ASSERT_EQUAL_STRING("Disconnected", test.messages_.back()->text.c_str());
+	}
+}
+
+/*
+ * Decoded records must be output in the same format as PrintHandler
+ * and use less than half as many bytes.
+ */
+void test_text_format() {
+	TestPrint text_print;
+	PrintHandler text_handler{text_print};
+	TestPrint binary_print;
+	BinaryHandler binary_handler{binary_print};
+	TestPrint decoded_print;
+	PrintHandler decoded_handler{decoded_print};
+	BinaryDecoder decoder{decoded_handler};
+
+	for (auto &message : sample_messages()) {
+		text_handler << message;
+		binary_handler << message;
+	}
+
+	text_handler.loop();
+	binary_handler.loop();
+	TEST_ASSERT_TRUE(decoder.decode(reinterpret_cast<const uint8_t *>(binary_print.output_.data()), binary_print.output_.size()));
+	decoded_handler.loop();
+
+	TEST_ASSERT_EQUAL_STRING(text_print.output_.c_str(), decoded_print.output_.c_str());
+	TEST_ASSERT_LESS_OR_EQUAL(text_print.output_.size() / 2, binary_print.output_.size());
+
+	char text[128];
+
+	std::snprintf(text, sizeof(text), "%zu bytes of binary records for %zu bytes of text",
+		binary_print.output_.size(), text_print.output_.size());
+	TEST_MESSAGE(text);
+}
+
+/*
+ * Messages must be discarded when the buffer is full, without losing
+ * logger names that are needed by later messages.
+ */
+void test_buffer_full() {
+	TestPrint print;
+	BinaryHandler handler{print};
+	Test test;
+	BinaryDecoder decoder{test};
+
+	handler.maximum_buffer_size(20);
+	TEST_ASSERT_EQUAL_INT(20, handler.maximum_buffer_size());
+
+	handler << create_message(0, Level::INFO, Facility::LOCAL0, "test", "Hello");
+	handler << create_message(0, Level::INFO, Facility::LOCAL0, "other", "World");
+	handler << create_message(0, Level::INFO, Facility::LOCAL0, "test", "Hello");
+	TEST_ASSERT_EQUAL_INT(2, handler.dropped_messages());
+
+	handler.loop();
+	handler << create_message(10, Level::INFO, Facility::LOCAL0, "other", "World");
+	handler.loop();
+
+	TEST_ASSERT_TRUE(decoder.decode(reinterpret_cast<const uint8_t *>(print.output_.data()), print.output_.size()));
+	TEST_ASSERT_EQUAL_INT(2, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("test", reinterpret_cast<const char *>(test.messages_[0]->name));
+	TEST_ASSERT_EQUAL_STRING("other", reinterpret_cast<const char *>(test.messages_[1]->name));
+	TEST_ASSERT_EQUAL_UINT64(10, test.messages_[1]->uptime_ms);
+}
+
+/*
+ * A new stream must be decoded after the handler is reset, and invalid
+ * records must be rejected.
+ */
+void test_reset() {
+	TestPrint print;
+	BinaryHandler handler{print};
+	Test test;
+	BinaryDecoder decoder{test};
+
+	handler << create_message(1000, Level::INFO, Facility::LOCAL0, "test", "Hello");
+	handler.loop();
+	handler.reset();
+	handler << create_message(2000, Level::INFO, Facility::LOCAL0, "other", "World");
+	handler.loop();
+
+	TEST_ASSERT_TRUE(decoder.decode(reinterpret_cast<const uint8_t *>(print.output_.data()), print.output_.size()));
+	TEST_ASSERT_EQUAL_INT(2, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("other", reinterpret_cast<const char *>(test.messages_[1]->name));
+	TEST_ASSERT_EQUAL_UINT64(2000, test.messages_[1]->uptime_ms);
+
+	const uint8_t unknown_name[] = { 0x00, 0x00, 0x05, 0x00 };
+	TEST_ASSERT_FALSE(decoder.decode(unknown_name, sizeof(unknown_name)));
+
+	const uint8_t invalid_type[] = { 0xFE };
+	TEST_ASSERT_FALSE(decoder.decode(invalid_type, sizeof(invalid_type)));
+
+	const uint8_t invalid_length[] = { 0xFF, 0x01, 0x80, 0x02 };
+	TEST_ASSERT_FALSE(decoder.decode(invalid_length, sizeof(invalid_length)));
+
+	TEST_ASSERT_EQUAL_INT(2, test.messages_.size());
+}
+
+/*
+ * Decoded messages that can't be allocated from an exhausted pool must
+ * be counted and not passed to the handler.
+ */
+void test_pool_exhausted() {
+	using uuid::log::MessagePool;
+	TestPrint print;
+	BinaryHandler handler{print};
+	TestPrint output;
+	PrintHandler queue{output};
+	BinaryDecoder decoder{queue};
+
+	handler << create_message(1, Level::INFO, Facility::LOCAL0, "test", "One");
+	handler << create_message(2, Level::INFO, Facility::LOCAL0, "test", "Two");
+	handler << create_message(3, Level::INFO, Facility::LOCAL0, "test", "Three");
+	handler.loop();
+
+	TEST_ASSERT_TRUE(MessagePool::configure(1, MessagePool::Policy::DROP, 16));
+	TEST_ASSERT_TRUE(decoder.decode(reinterpret_cast<const uint8_t *>(print.output_.data()), print.output_.size()));
+	TEST_ASSERT_EQUAL_INT(2, decoder.dropped_messages());
+
+	queue.loop();
+	TEST_ASSERT_EQUAL_STRING("000+00:00:00.001 I [test] One\r\n", output.output_.c_str());
+	TEST_ASSERT_TRUE(MessagePool::configure(0));
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_round_trip);
+	RUN_TEST(test_split);
+	RUN_TEST(test_text_format);
+	RUN_TEST(test_buffer_full);
+	RUN_TEST(test_reset);
+	RUN_TEST(test_pool_exhausted);
+
+	return UNITY_END();
+}
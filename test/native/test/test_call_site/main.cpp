@@ -0,0 +1,264 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <uuid/log.h>
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		messages_.push_back(message);
+	}
+
+	std::vector<std::shared_ptr<uuid::log::Message>> messages_;
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return 0;
+}
+
+} // namespace uuid
+
+static unsigned int evaluated = 0;
+
+static unsigned int evaluate(unsigned int value) {
+	evaluated++;
+	return value;
+}
+
+static const char logger_name[] __attribute__((aligned(4))) PROGMEM = "test";
+static uuid::log::Logger logger{FPSTR(logger_name), uuid::log::Facility::LOCAL0};
+
+static const unsigned int debug_line = __LINE__ + 2;
+static void log_debug(unsigned int value) {
+	UUID_LOG_SITE(logger, DEBUG, "Debug %u", evaluate(value));
+}
+
+static const unsigned int info_line = __LINE__ + 2;
+static void log_info(unsigned int value) {
+	UUID_LOG_SITE(logger, INFO, "Info %u", evaluate(value));
+}
+
+static void log_shared1(const uuid::log::Logger &logger, unsigned int value) {
+	UUID_LOG_SITE(logger, DEBUG, "Debug %u", evaluate(value));
+}
+
+static void log_shared2(const uuid::log::Logger &logger, unsigned int value) {
+	UUID_LOG_SITE(logger, DEBUG, "Debug %u", evaluate(value));
+}
+
+static uuid::log::CallSite *find(unsigned int line) {
+	for (auto *site = uuid::log::CallSite::first(); site != nullptr; site = site->next()) {
+		if (site->line() == line && !::strcmp(site->file(), __FILE__)) {
+			return site;
+		}
+	}
+	return nullptr;
+}
+
+static void reset() {
+	uuid::log::CallSite::mode(__FILE__, 0, uuid::log::CallSite::Mode::DEFAULT);
+	logger.level(uuid::log::Level::ALL);
+	evaluated = 0;
+}
+
+/*
+ * Call sites must follow changes to the level of the logger and the
+ * registered handlers, and the arguments of disabled messages must not
+ * be evaluated.
+ */
+void test_levels() {
+	Test test;
+
+	reset();
+
+	log_debug(1);
+	log_info(1);
+	TEST_ASSERT_EQUAL_INT(0, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(0, evaluated);
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+	log_debug(2);
+	log_info(2);
+	TEST_ASSERT_EQUAL_INT(1, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Info 2", test.messages_[0]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::INFO, test.messages_[0]->level);
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::DEBUG);
+	log_debug(3);
+	log_info(3);
+	TEST_ASSERT_EQUAL_INT(3, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Debug 3", test.messages_[1]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, test.messages_[1]->level);
+	TEST_ASSERT_EQUAL_STRING("Info 3", test.messages_[2]->text.c_str());
+
+	logger.level(uuid::log::Level::NOTICE);
+	log_debug(4);
+	log_info(4);
+	TEST_ASSERT_EQUAL_INT(3, test.messages_.size());
+
+	logger.level(uuid::log::Level::INFO);
+	log_debug(5);
+	log_info(5);
+	TEST_ASSERT_EQUAL_INT(4, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Info 5", test.messages_[3]->text.c_str());
+
+	uuid::log::Logger::unregister_handler(&test);
+	log_debug(6);
+	log_info(6);
+	TEST_ASSERT_EQUAL_INT(4, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(4, evaluated);
+}
+
+/*
+ * Call sites can be enabled regardless of the level of the logger, but
+ * not when no handler is interested in the level, and they can be
+ * disabled regardless of any level.
+ */
+void test_modes() {
+	Test test;
+
+	reset();
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::DEBUG);
+	logger.level(uuid::log::Level::WARNING);
+
+	log_debug(1);
+	log_info(1);
+	TEST_ASSERT_EQUAL_INT(0, test.messages_.size());
+
+	TEST_ASSERT_NOT_NULL(find(debug_line));
+	TEST_ASSERT_NOT_NULL(find(info_line));
+	TEST_ASSERT_EQUAL_INT(uuid::log::CallSite::Mode::DEFAULT, find(debug_line)->mode());
+
+	find(debug_line)->mode(uuid::log::CallSite::Mode::ENABLED);
+	TEST_ASSERT_EQUAL_INT(uuid::log::CallSite::Mode::ENABLED, find(debug_line)->mode());
+	log_debug(2);
+	log_info(2);
+	TEST_ASSERT_EQUAL_INT(1, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Debug 2", test.messages_[0]->text.c_str());
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+	log_debug(3);
+	TEST_ASSERT_EQUAL_INT(1, test.messages_.size());
+
+	logger.level(uuid::log::Level::ALL);
+	TEST_ASSERT_EQUAL_INT(1, uuid::log::CallSite::mode("main.cpp", info_line, uuid::log::CallSite::Mode::DISABLED));
+	log_debug(4);
+	log_info(4);
+	TEST_ASSERT_EQUAL_INT(1, test.messages_.size());
+
+	TEST_ASSERT_EQUAL_INT(1, uuid::log::CallSite::mode("main.cpp", info_line, uuid::log::CallSite::Mode::DEFAULT));
+	log_info(5);
+	TEST_ASSERT_EQUAL_INT(2, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Info 5", test.messages_[1]->text.c_str());
+}
+
+/*
+ * Call sites must only be matched by complete file names or complete
+ * components of file names.
+ */
+void test_files() {
+	reset();
+
+	log_debug(1);
+	log_info(1);
+
+	TEST_ASSERT_EQUAL_INT(2, uuid::log::CallSite::mode(__FILE__, 0, uuid::log::CallSite::Mode::DISABLED));
+	TEST_ASSERT_EQUAL_INT(2, uuid::log::CallSite::mode("main.cpp", 0, uuid::log::CallSite::Mode::DISABLED));
+	TEST_ASSERT_EQUAL_INT(1, uuid::log::CallSite::mode("main.cpp", debug_line, uuid::log::CallSite::Mode::DISABLED));
+	TEST_ASSERT_EQUAL_INT(0, uuid::log::CallSite::mode("ain.cpp", 0, uuid::log::CallSite::Mode::DISABLED));
+	TEST_ASSERT_EQUAL_INT(0, uuid::log::CallSite::mode("main.cpp", 1, uuid::log::CallSite::Mode::DISABLED));
+	TEST_ASSERT_EQUAL_INT(0, uuid::log::CallSite::mode("other.cpp", 0, uuid::log::CallSite::Mode::DISABLED));
+
+	size_t count = 0;
+	for (auto *site = uuid::log::CallSite::first(); site != nullptr; site = site->next()) {
+		count++;
+	}
+	TEST_ASSERT_EQUAL_INT(2, count);
+}
+
+/*
+ * Call sites used with more than one logger must use the level of the
+ * logger for each call, in whichever order the loggers are used.
+ */
+void test_loggers() {
+	static const char logger_all_name[] __attribute__((aligned(4))) PROGMEM = "all";
+	static const char logger_info_name[] __attribute__((aligned(4))) PROGMEM = "info";
+	Test test;
+	uuid::log::Logger logger_all{FPSTR(logger_all_name), uuid::log::Facility::LOCAL0};
+	uuid::log::Logger logger_info{FPSTR(logger_info_name), uuid::log::Facility::LOCAL0};
+
+	reset();
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+	logger_all.level(uuid::log::Level::ALL);
+	logger_info.level(uuid::log::Level::INFO);
+
+	for (unsigned int i = 1; i <= 2; i++) {
+		log_shared1(logger_all, i);
+		log_shared1(logger_info, i);
+	}
+	TEST_ASSERT_EQUAL_INT(2, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(2, evaluated);
+	TEST_ASSERT_EQUAL_STRING("all", reinterpret_cast<const char *>(test.messages_[0]->name));
+	TEST_ASSERT_EQUAL_STRING("all", reinterpret_cast<const char *>(test.messages_[1]->name));
+
+	test.messages_.clear();
+	evaluated = 0;
+	for (unsigned int i = 1; i <= 2; i++) {
+		log_shared2(logger_info, i);
+		log_shared2(logger_all, i);
+	}
+	TEST_ASSERT_EQUAL_INT(2, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(2, evaluated);
+	TEST_ASSERT_EQUAL_STRING("all", reinterpret_cast<const char *>(test.messages_[0]->name));
+	TEST_ASSERT_EQUAL_STRING("all", reinterpret_cast<const char *>(test.messages_[1]->name));
+
+	test.messages_.clear();
+	logger_all.level(uuid::log::Level::INFO);
+	logger_info.level(uuid::log::Level::ALL);
+	log_shared1(logger_all, 3);
+	log_shared1(logger_info, 3);
+	log_shared2(logger_info, 3);
+	log_shared2(logger_all, 3);
+	TEST_ASSERT_EQUAL_INT(2, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("info", reinterpret_cast<const char *>(test.messages_[0]->name));
+	TEST_ASSERT_EQUAL_STRING("info", reinterpret_cast<const char *>(test.messages_[1]->name));
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_levels);
+	RUN_TEST(test_modes);
+	RUN_TEST(test_files);
+	RUN_TEST(test_loggers);
+
+	return UNITY_END();
+}
@@ -0,0 +1,187 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <uuid/log.h>
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		message_ = message;
+	}
+
+	std::shared_ptr<uuid::log::Message> message_;
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static uint64_t millis = 0;
+	return ++millis;
+}
+
+} // namespace uuid
+
+class Alignment: public uuid::log::MessageFormat {
+public:
+	size_t size() const override {
+		return sizeof(*this);
+	}
+
+	const uuid::log::MessageFormat *store(void *storage) const override {
+		misaligned_ = reinterpret_cast<uintptr_t>(storage) % alignof(std::max_align_t);
+		return ::new (storage) Alignment(*this);
+	}
+
+	int format(char *buffer, size_t size) const override {
+		return snprintf(buffer, size, "%zu", misaligned_);
+	}
+
+	static size_t misaligned_;
+};
+
+size_t Alignment::misaligned_ = 0;
+
+/*
+ * Messages must not be formatted until the text is used, and then the
+ * formatted text must be reused.
+ */
+void test_deferred() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+	logger.logd(uuid::log::Level::INFO, "Hello, %u World! %d %.1f %c", 42U, -1, 0.5, 'x');
+
+	TEST_ASSERT_TRUE_MESSAGE(test.message_, "Handler must have the message");
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::INFO, test.message_->level);
+	TEST_ASSERT_EQUAL_INT(uuid::log::Facility::LOCAL0, test.message_->facility);
+	TEST_ASSERT_FALSE_MESSAGE(test.message_->text.formatted(), "Message must not be formatted yet");
+
+	const char *text = test.message_->text.c_str();
+
+	TEST_ASSERT_TRUE_MESSAGE(test.message_->text.formatted(), "Message must be formatted");
+	TEST_ASSERT_EQUAL_STRING("Hello, 42 World! -1 0.5 x", text);
+	TEST_ASSERT_EQUAL_INT(25, test.message_->text.length());
+	TEST_ASSERT_TRUE_MESSAGE(text == test.message_->text.c_str(), "Formatted text must be cached");
+}
+
+/*
+ * String arguments must be copied so that they can be modified after
+ * the message is logged.
+ */
+void test_strings() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	char buffer[16];
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	std::strcpy(buffer, "before");
+	logger.logd(uuid::log::Level::NOTICE, uuid::log::Facility::DAEMON, F("%s/%s/%s"), buffer, "literal", (const char *)nullptr);
+	std::strcpy(buffer, "after");
+
+	TEST_ASSERT_TRUE_MESSAGE(test.message_, "Handler must have the message");
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::NOTICE, test.message_->level);
+	TEST_ASSERT_EQUAL_INT(uuid::log::Facility::DAEMON, test.message_->facility);
+	TEST_ASSERT_EQUAL_STRING("before/literal/(null)", test.message_->text.c_str());
+}
+
+/*
+ * Format strings without arguments must still be formatted.
+ */
+void test_no_arguments() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+	logger.logd(uuid::log::Level::INFO, F("100%% complete"));
+
+	TEST_ASSERT_TRUE_MESSAGE(test.message_, "Handler must have the message");
+	TEST_ASSERT_EQUAL_STRING("100% complete", std::string(test.message_->text).c_str());
+}
+
+/*
+ * Messages must not be created when the level is not enabled.
+ */
+void test_disabled() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+	logger.logd(uuid::log::Level::DEBUG, "Hello, %u World!", 42);
+
+	TEST_ASSERT_FALSE_MESSAGE(test.message_, "Handler must not have the message");
+}
+
+/*
+ * Arguments must be stored in memory aligned for any type, whether the
+ * message is allocated from the heap or the pool.
+ */
+void test_alignment() {
+	using uuid::log::MessagePool;
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	Alignment::misaligned_ = SIZE_MAX;
+	TEST_ASSERT_TRUE(uuid::log::Message::create(0, uuid::log::Level::INFO, uuid::log::Facility::LOCAL0, F("test"), Alignment{}));
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, Alignment::misaligned_, "Heap storage must be aligned");
+
+	logger.logd(uuid::log::Level::INFO, "%.1Lf", 1.5L);
+	TEST_ASSERT_EQUAL_STRING("1.5", test.message_->text.c_str());
+
+	TEST_ASSERT_TRUE(MessagePool::configure(1, MessagePool::Policy::DROP, 64));
+
+	Alignment::misaligned_ = SIZE_MAX;
+	TEST_ASSERT_TRUE(uuid::log::Message::create(0, uuid::log::Level::INFO, uuid::log::Facility::LOCAL0, F("test"), Alignment{}));
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, Alignment::misaligned_, "Pool storage must be aligned");
+	TEST_ASSERT_EQUAL_INT(1, MessagePool::pool_allocations());
+
+	test.message_.reset();
+	logger.logd(uuid::log::Level::INFO, "%.1Lf", 2.5L);
+	TEST_ASSERT_EQUAL_STRING("2.5", test.message_->text.c_str());
+	TEST_ASSERT_EQUAL_INT(2, MessagePool::pool_allocations());
+
+	test.message_.reset();
+	TEST_ASSERT_TRUE(MessagePool::configure(0));
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_deferred);
+	RUN_TEST(test_strings);
+	RUN_TEST(test_no_arguments);
+	RUN_TEST(test_disabled);
+	RUN_TEST(test_alignment);
+	return UNITY_END();
+}
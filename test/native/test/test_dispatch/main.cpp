@@ -0,0 +1,240 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <uuid/log.h>
+
+#if UUID_LOG_THREAD_SAFE && defined(__linux__)
+# include <dlfcn.h>
+# include <pthread.h>
+#endif
+
+#if UUID_LOG_THREAD_SAFE && defined(__linux__)
+static thread_local unsigned long mutex_locks = 0;
+
+/*
+ * Count the mutexes locked by this thread, including those locked
+ * internally by the standard library.
+ */
+extern "C" int pthread_mutex_lock(pthread_mutex_t *mutex) {
+	using function = int (*)(pthread_mutex_t *);
+	static std::atomic<function> real{nullptr};
+	function lock = real.load();
+
+	if (!lock) {
+		lock = reinterpret_cast<function>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+		real.store(lock);
+	}
+
+	mutex_locks++;
+	return lock(mutex);
+}
+#endif
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		if (!registered_.load()) {
+			late_++;
+		}
+		calls_++;
+#if UUID_LOG_THREAD_SAFE
+		std::this_thread::yield();
+#endif
+	}
+
+	std::atomic<bool> registered_{false};
+	std::atomic<unsigned long> calls_{0};
+	std::atomic<unsigned long> late_{0};
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static std::atomic<uint64_t> millis{0};
+	return ++millis;
+}
+
+} // namespace uuid
+
+/*
+ * Handlers must not be called after they have been unregistered.
+ */
+void test_unregister() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	test.registered_ = true;
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+	logger.info("Hello, World!");
+	TEST_ASSERT_EQUAL_UINT(1, test.calls_.load());
+
+	uuid::log::Logger::unregister_handler(&test);
+	test.registered_ = false;
+	logger.info("Hello, World!");
+	TEST_ASSERT_EQUAL_UINT(1, test.calls_.load());
+	TEST_ASSERT_EQUAL_UINT(0, test.late_.load());
+}
+
+#if UUID_LOG_THREAD_SAFE && defined(__linux__)
+/*
+ * Dispatching messages must not lock any mutexes, so that threads
+ * logging concurrently don't wait for each other.
+ */
+void test_lock_free() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	unsigned long before;
+
+	test.registered_ = true;
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+
+	before = mutex_locks;
+	{
+		std::mutex mutex;
+		std::lock_guard<std::mutex> lock{mutex};
+	}
+	TEST_ASSERT_EQUAL_UINT_MESSAGE(1, mutex_locks - before, "Mutex locks must be counted");
+
+	before = mutex_locks;
+	logger.info("Hello, World!");
+	logger.logd(uuid::log::Level::INFO, "Hello, %u World!", 42);
+	TEST_ASSERT_EQUAL_UINT(2, test.calls_.load());
+	TEST_ASSERT_EQUAL_UINT_MESSAGE(0, mutex_locks - before, "Dispatch must not lock a mutex");
+}
+#endif
+
+#if UUID_LOG_THREAD_SAFE
+static constexpr unsigned int THREADS = 4;
+static constexpr unsigned int ITERATIONS = 200;
+
+/*
+ * Log messages continuously from other threads until stopped.
+ */
+static std::vector<std::thread> start_logging(uuid::log::Logger &logger, std::atomic<bool> &stop) {
+	std::vector<std::thread> threads;
+
+	for (unsigned int i = 0; i < THREADS; i++) {
+		threads.emplace_back([&logger, &stop, i] {
+			while (!stop.load()) {
+				logger.info("Hello %u", i);
+			}
+		});
+	}
+
+	return threads;
+}
+
+/*
+ * Handlers must not be called after unregister_handler() returns, even
+ * when messages are being dispatched concurrently.
+ */
+void test_unregister_threads() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	std::atomic<bool> stop{false};
+	auto threads = start_logging(logger, stop);
+
+	for (unsigned int i = 0; i < ITERATIONS; i++) {
+		const unsigned long calls = test.calls_.load();
+
+		test.registered_ = true;
+		uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+
+		while (test.calls_.load() == calls) {
+			std::this_thread::yield();
+		}
+
+		uuid::log::Logger::unregister_handler(&test);
+		test.registered_ = false;
+
+		for (unsigned int j = 0; j < 10; j++) {
+			std::this_thread::yield();
+		}
+	}
+
+	stop = true;
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	TEST_ASSERT_GREATER_OR_EQUAL(ITERATIONS, test.calls_.load());
+	TEST_ASSERT_EQUAL_UINT_MESSAGE(0, test.late_.load(), "Handler must not be called after it is unregistered");
+}
+
+/*
+ * Handlers must be able to be destroyed as soon as they have been
+ * unregistered, even when messages are being dispatched concurrently.
+ */
+void test_destroy_threads() {
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	std::atomic<bool> stop{false};
+	auto threads = start_logging(logger, stop);
+	unsigned long late = 0;
+
+	for (unsigned int i = 0; i < ITERATIONS; i++) {
+		std::unique_ptr<Test> test{new Test};
+
+		test->registered_ = true;
+		uuid::log::Logger::register_handler(test.get(), uuid::log::Level::INFO);
+
+		while (test->calls_.load() == 0) {
+			std::this_thread::yield();
+		}
+
+		uuid::log::Logger::unregister_handler(test.get());
+		test->registered_ = false;
+		std::this_thread::yield();
+		late += test->late_.load();
+	}
+
+	stop = true;
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	TEST_ASSERT_EQUAL_UINT_MESSAGE(0, late, "Handler must not be called after it is unregistered");
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::global_level());
+}
+#endif
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_unregister);
+#if UUID_LOG_THREAD_SAFE && defined(__linux__)
+	RUN_TEST(test_lock_free);
+#endif
+#if UUID_LOG_THREAD_SAFE
+	RUN_TEST(test_unregister_threads);
+	RUN_TEST(test_destroy_threads);
+#endif
+	return UNITY_END();
+}
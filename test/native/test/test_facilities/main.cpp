@@ -0,0 +1,165 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <uuid/log.h>
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		message_ = message;
+		count_++;
+	}
+
+	std::shared_ptr<uuid::log::Message> message_;
+	unsigned int count_ = 0;
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static uint64_t millis = 0;
+	return ++millis;
+}
+
+} // namespace uuid
+
+/*
+ * Levels must only be enabled for facilities that a handler is
+ * interested in.
+ */
+void test_enabled() {
+	Test test;
+	uuid::log::Logger logger0{F("test0"), uuid::log::Facility::LOCAL0};
+	uuid::log::Logger logger2{F("test2"), uuid::log::Facility::LOCAL2};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::DEBUG,
+		uuid::log::facility_mask(uuid::log::Facility::LOCAL0) | uuid::log::facility_mask(uuid::log::Facility::LOCAL1));
+
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, uuid::log::Logger::global_level());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, uuid::log::Logger::global_level(uuid::log::Facility::LOCAL0));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, uuid::log::Logger::global_level(uuid::log::Facility::LOCAL1));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::global_level(uuid::log::Facility::LOCAL2));
+
+	TEST_ASSERT_TRUE(logger0.enabled(uuid::log::Level::DEBUG));
+	TEST_ASSERT_FALSE(logger0.enabled(uuid::log::Level::TRACE));
+	TEST_ASSERT_FALSE(logger2.enabled(uuid::log::Level::EMERG));
+	TEST_ASSERT_TRUE(logger2.enabled(uuid::log::Level::DEBUG, uuid::log::Facility::LOCAL1));
+	TEST_ASSERT_FALSE(logger0.enabled(uuid::log::Level::EMERG, uuid::log::Facility::KERN));
+
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, logger0.effective_level());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, logger2.effective_level());
+}
+
+/*
+ * Messages must only be dispatched to handlers that are interested in
+ * their facility.
+ */
+void test_dispatch() {
+	Test test_local0;
+	Test test_all;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test_local0, uuid::log::Level::INFO,
+		uuid::log::facility_mask(uuid::log::Facility::LOCAL0));
+	uuid::log::Logger::register_handler(&test_all, uuid::log::Level::ERR);
+
+	logger.info("Hello, %u World!", 0);
+	TEST_ASSERT_EQUAL_UINT(1, test_local0.count_);
+	TEST_ASSERT_EQUAL_UINT(0, test_all.count_);
+
+	logger.log(uuid::log::Level::INFO, uuid::log::Facility::LOCAL1, "Hello, %u World!", 1);
+	TEST_ASSERT_EQUAL_UINT(1, test_local0.count_);
+	TEST_ASSERT_EQUAL_UINT(0, test_all.count_);
+
+	logger.log(uuid::log::Level::ERR, uuid::log::Facility::LOCAL1, F("Hello, %u World!"), 2);
+	TEST_ASSERT_EQUAL_UINT(1, test_local0.count_);
+	TEST_ASSERT_EQUAL_UINT(1, test_all.count_);
+	TEST_ASSERT_EQUAL_INT(uuid::log::Facility::LOCAL1, test_all.message_->facility);
+	TEST_ASSERT_EQUAL_STRING("Hello, 2 World!", test_all.message_->text.c_str());
+
+	logger.err("Hello, %u World!", 3);
+	TEST_ASSERT_EQUAL_UINT(2, test_local0.count_);
+	TEST_ASSERT_EQUAL_UINT(2, test_all.count_);
+
+	logger.logp(uuid::log::Level::WARNING, uuid::log::Facility::KERN, "Hello, World!");
+	logger.logd(uuid::log::Level::NOTICE, uuid::log::Facility::DAEMON, "Hello, %u World!", 4);
+	TEST_ASSERT_EQUAL_UINT(2, test_local0.count_);
+	TEST_ASSERT_EQUAL_UINT(2, test_all.count_);
+}
+
+/*
+ * Registering a handler again must replace its facilities and
+ * unregistering it must disable all facilities.
+ */
+void test_reregister() {
+	Test test;
+
+	TEST_ASSERT_EQUAL_UINT32(uuid::log::ALL_FACILITIES, uuid::log::Logger::get_facilities(&test));
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::NOTICE,
+		uuid::log::facility_mask(uuid::log::Facility::DAEMON));
+	TEST_ASSERT_EQUAL_UINT32(uuid::log::facility_mask(uuid::log::Facility::DAEMON), uuid::log::Logger::get_facilities(&test));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::NOTICE, uuid::log::Logger::global_level(uuid::log::Facility::DAEMON));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::global_level(uuid::log::Facility::LOCAL7));
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+	TEST_ASSERT_EQUAL_UINT32(uuid::log::ALL_FACILITIES, uuid::log::Logger::get_facilities(&test));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::INFO, uuid::log::Logger::global_level(uuid::log::Facility::DAEMON));
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::INFO, uuid::log::Logger::global_level(uuid::log::Facility::LOCAL7));
+
+	uuid::log::Logger::unregister_handler(&test);
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::global_level());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::global_level(uuid::log::Facility::DAEMON));
+}
+
+/*
+ * A handler that is not interested in any facilities must not enable
+ * any log levels.
+ */
+void test_no_facilities() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL, 0);
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::OFF, uuid::log::Logger::global_level());
+	TEST_ASSERT_FALSE(logger.enabled(uuid::log::Level::EMERG));
+
+	logger.emerg("Hello, World!");
+	TEST_ASSERT_EQUAL_UINT(0, test.count_);
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_enabled);
+	RUN_TEST(test_dispatch);
+	RUN_TEST(test_reregister);
+	RUN_TEST(test_no_facilities);
+	return UNITY_END();
+}
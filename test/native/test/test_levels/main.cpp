@@ -0,0 +1,133 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <string>
+
+#include <uuid/log.h>
+
+using uuid::log::Level;
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static uint64_t millis = 0;
+	return ++millis;
+}
+
+} // namespace uuid
+
+static const char *uppercase_names[] = { "OFF", "EMERG", "ALERT", "CRIT", "ERR", "WARNING", "NOTICE", "INFO", "DEBUG", "TRACE", "ALL" };
+static const char *lowercase_names[] = { "off", "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug", "trace", "all" };
+
+/*
+ * Every level must be formatted with its own name.
+ */
+void test_format() {
+	for (int i = Level::OFF; i <= Level::ALL; i++) {
+		Level level = static_cast<Level>(i);
+
+		TEST_ASSERT_EQUAL_STRING(uppercase_names[i + 1], reinterpret_cast<const char *>(uuid::log::format_level_uppercase(level)));
+		TEST_ASSERT_EQUAL_STRING(lowercase_names[i + 1], reinterpret_cast<const char *>(uuid::log::format_level_lowercase(level)));
+	}
+}
+
+/*
+ * Every level name must be parsed back to the same level.
+ */
+void test_parse() {
+	for (int i = Level::OFF; i <= Level::ALL; i++) {
+		Level expected = static_cast<Level>(i);
+		Level level;
+
+		level = Level::OFF;
+		TEST_ASSERT_TRUE(uuid::log::parse_level_uppercase(uppercase_names[i + 1], level));
+		TEST_ASSERT_EQUAL_INT(expected, level);
+
+		level = Level::OFF;
+		TEST_ASSERT_TRUE(uuid::log::parse_level_uppercase(std::string{uppercase_names[i + 1]}, level));
+		TEST_ASSERT_EQUAL_INT(expected, level);
+
+		level = Level::OFF;
+		TEST_ASSERT_TRUE(uuid::log::parse_level_lowercase(lowercase_names[i + 1], level));
+		TEST_ASSERT_EQUAL_INT(expected, level);
+
+		level = Level::OFF;
+		TEST_ASSERT_TRUE(uuid::log::parse_level_lowercase(std::string{lowercase_names[i + 1]}, level));
+		TEST_ASSERT_EQUAL_INT(expected, level);
+
+		TEST_ASSERT_FALSE(uuid::log::parse_level_uppercase(lowercase_names[i + 1], level));
+		TEST_ASSERT_FALSE(uuid::log::parse_level_lowercase(uppercase_names[i + 1], level));
+	}
+}
+
+/*
+ * Names that are not exactly a level name must not be parsed.
+ */
+void test_parse_invalid() {
+	Level level = Level::INFO;
+
+	TEST_ASSERT_FALSE(uuid::log::parse_level_uppercase("", level));
+	TEST_ASSERT_FALSE(uuid::log::parse_level_uppercase("E", level));
+	TEST_ASSERT_FALSE(uuid::log::parse_level_uppercase("ERRO", level));
+	TEST_ASSERT_FALSE(uuid::log::parse_level_uppercase("INFOS", level));
+	TEST_ASSERT_FALSE(uuid::log::parse_level_uppercase("NOTICe", level));
+	TEST_ASSERT_FALSE(uuid::log::parse_level_uppercase("WARNINGS", level));
+	TEST_ASSERT_FALSE(uuid::log::parse_level_uppercase(std::string{"OF\0", 3}, level));
+	TEST_ASSERT_FALSE(uuid::log::parse_level_lowercase("Info", level));
+	TEST_ASSERT_FALSE(uuid::log::parse_level_lowercase("debug ", level));
+	TEST_ASSERT_EQUAL_INT(Level::INFO, level);
+
+	TEST_ASSERT_TRUE(uuid::log::parse_level_uppercase("DEBUGGING", 5, level));
+	TEST_ASSERT_EQUAL_INT(Level::DEBUG, level);
+	TEST_ASSERT_TRUE(uuid::log::parse_level_lowercase("errors", 3, level));
+	TEST_ASSERT_EQUAL_INT(Level::ERR, level);
+}
+
+/*
+ * The static arrays must match the lists of levels and names.
+ */
+void test_static() {
+	auto levels = uuid::log::levels();
+	auto uppercase = uuid::log::levels_uppercase();
+	auto lowercase = uuid::log::levels_lowercase();
+
+	TEST_ASSERT_EQUAL_INT(uuid::log::NUM_LEVELS, levels.size());
+	TEST_ASSERT_EQUAL_INT(uuid::log::NUM_LEVELS, uppercase.size());
+	TEST_ASSERT_EQUAL_INT(uuid::log::NUM_LEVELS, lowercase.size());
+
+	for (size_t i = 0; i < uuid::log::NUM_LEVELS; i++) {
+		TEST_ASSERT_EQUAL_INT(static_cast<int>(i) - 1, uuid::log::all_levels()[i]);
+		TEST_ASSERT_EQUAL_INT(uuid::log::all_levels()[i], levels[i]);
+		TEST_ASSERT_EQUAL_STRING(uppercase_names[i], reinterpret_cast<const char *>(uuid::log::level_names_uppercase()[i]));
+		TEST_ASSERT_EQUAL_STRING(lowercase_names[i], reinterpret_cast<const char *>(uuid::log::level_names_lowercase()[i]));
+		TEST_ASSERT_EQUAL_STRING(uppercase_names[i], uppercase[i].c_str());
+		TEST_ASSERT_EQUAL_STRING(lowercase_names[i], lowercase[i].c_str());
+	}
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_format);
+	RUN_TEST(test_parse);
+	RUN_TEST(test_parse_invalid);
+	RUN_TEST(test_static);
+	return UNITY_END();
+}
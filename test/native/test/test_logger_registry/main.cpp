@@ -0,0 +1,215 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <uuid/log.h>
+
+using ::uuid::log::Level;
+using ::uuid::log::Logger;
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return 0;
+}
+
+} // namespace uuid
+
+/*
+ * Registered loggers must be found by name until they're unregistered
+ * or destroyed.
+ */
+void test_find() {
+	Logger wifi{F("wifi")};
+	Logger mqtt{F("mqtt")};
+	Logger mqtt2{F("mqtt")};
+	std::unique_ptr<Logger> temporary{new Logger{F("temp")}};
+
+	TEST_ASSERT_NULL(Logger::find_logger("wifi"));
+
+	Logger::register_logger(&wifi);
+	Logger::register_logger(&mqtt);
+	Logger::register_logger(&wifi);
+	Logger::register_logger(temporary.get());
+
+	TEST_ASSERT_EQUAL_PTR(&wifi, Logger::find_logger("wifi"));
+	TEST_ASSERT_EQUAL_PTR(&mqtt, Logger::find_logger("mqtt"));
+	TEST_ASSERT_EQUAL_PTR(temporary.get(), Logger::find_logger("temp"));
+	TEST_ASSERT_NULL(Logger::find_logger("mqt"));
+	TEST_ASSERT_NULL(Logger::find_logger("mqtt2"));
+	TEST_ASSERT_NULL(Logger::find_logger(""));
+
+	Logger::unregister_logger(&mqtt);
+	Logger::unregister_logger(&mqtt);
+	TEST_ASSERT_NULL(Logger::find_logger("mqtt"));
+
+	Logger::register_logger(&mqtt2);
+	TEST_ASSERT_EQUAL_PTR(&mqtt2, Logger::find_logger("mqtt"));
+	Logger::unregister_logger(&mqtt2);
+
+	temporary.reset();
+	TEST_ASSERT_NULL(Logger::find_logger("temp"));
+
+	Logger::unregister_logger(&wifi);
+	TEST_ASSERT_NULL(Logger::find_logger("wifi"));
+}
+
+/*
+ * Levels must be set for all loggers that match a pattern.
+ */
+void test_patterns() {
+	Logger wifi{F("wifi")};
+	Logger wifi_ap{F("wifi.ap")};
+	Logger wifi_sta{F("wifi.sta")};
+	Logger mqtt{F("mqtt")};
+	Logger mqtt2{F("mqtt")};
+	Logger unregistered{F("wifi.other")};
+
+	Logger::register_logger(&wifi);
+	Logger::register_logger(&wifi_ap);
+	Logger::register_logger(&wifi_sta);
+	Logger::register_logger(&mqtt);
+	Logger::register_logger(&mqtt2);
+
+	TEST_ASSERT_EQUAL_INT(2, Logger::configure_level("mqtt", Level::WARNING));
+	TEST_ASSERT_EQUAL_INT(Level::WARNING, mqtt.level());
+	TEST_ASSERT_EQUAL_INT(Level::WARNING, mqtt2.level());
+	TEST_ASSERT_EQUAL_INT(Level::ALL, wifi.level());
+
+	TEST_ASSERT_EQUAL_INT(2, Logger::configure_level("wifi.*", Level::DEBUG));
+	TEST_ASSERT_EQUAL_INT(Level::ALL, wifi.level());
+	TEST_ASSERT_EQUAL_INT(Level::DEBUG, wifi_ap.level());
+	TEST_ASSERT_EQUAL_INT(Level::DEBUG, wifi_sta.level());
+	TEST_ASSERT_EQUAL_INT(Level::ALL, unregistered.level());
+
+	TEST_ASSERT_EQUAL_INT(3, Logger::configure_level("wifi*", Level::INFO));
+	TEST_ASSERT_EQUAL_INT(Level::INFO, wifi.level());
+	TEST_ASSERT_EQUAL_INT(Level::INFO, wifi_ap.level());
+	TEST_ASSERT_EQUAL_INT(Level::INFO, wifi_sta.level());
+
+	TEST_ASSERT_EQUAL_INT(1, Logger::configure_level("wifi.?p", Level::ERR));
+	TEST_ASSERT_EQUAL_INT(Level::ERR, wifi_ap.level());
+
+	TEST_ASSERT_EQUAL_INT(2, Logger::configure_level("*.*a*", Level::CRIT));
+	TEST_ASSERT_EQUAL_INT(Level::CRIT, wifi_ap.level());
+	TEST_ASSERT_EQUAL_INT(Level::CRIT, wifi_sta.level());
+
+	TEST_ASSERT_EQUAL_INT(3, Logger::configure_level("*i*", Level::NOTICE));
+	TEST_ASSERT_EQUAL_INT(Level::NOTICE, wifi.level());
+	TEST_ASSERT_EQUAL_INT(Level::NOTICE, wifi_sta.level());
+	TEST_ASSERT_EQUAL_INT(Level::WARNING, mqtt.level());
+
+	TEST_ASSERT_EQUAL_INT(2, Logger::configure_level("*t", Level::TRACE));
+	TEST_ASSERT_EQUAL_INT(Level::TRACE, mqtt.level());
+	TEST_ASSERT_EQUAL_INT(Level::TRACE, mqtt2.level());
+	TEST_ASSERT_EQUAL_INT(0, Logger::configure_level("wifi.", Level::OFF));
+	TEST_ASSERT_EQUAL_INT(0, Logger::configure_level("", Level::OFF));
+	TEST_ASSERT_EQUAL_INT(0, Logger::configure_level("x*", Level::OFF));
+
+	TEST_ASSERT_EQUAL_INT(5, Logger::configure_level("*", Level::ALL));
+	TEST_ASSERT_EQUAL_INT(Level::ALL, mqtt.level());
+	TEST_ASSERT_EQUAL_INT(Level::ALL, wifi_sta.level());
+}
+
+/*
+ * Level specifications must be applied in order, and not at all if
+ * they're invalid.
+ */
+void test_specs() {
+	Logger wifi{F("wifi")};
+	Logger mqtt{F("mqtt")};
+	Logger sensor{F("sensor")};
+
+	Logger::register_logger(&wifi);
+	Logger::register_logger(&mqtt);
+	Logger::register_logger(&sensor);
+
+	TEST_ASSERT_TRUE(Logger::configure_levels("wifi=debug,mqtt=warning"));
+	TEST_ASSERT_EQUAL_INT(Level::DEBUG, wifi.level());
+	TEST_ASSERT_EQUAL_INT(Level::WARNING, mqtt.level());
+	TEST_ASSERT_EQUAL_INT(Level::ALL, sensor.level());
+
+	TEST_ASSERT_TRUE(Logger::configure_levels(" info , s* = TRACE,,"));
+	TEST_ASSERT_EQUAL_INT(Level::INFO, wifi.level());
+	TEST_ASSERT_EQUAL_INT(Level::INFO, mqtt.level());
+	TEST_ASSERT_EQUAL_INT(Level::TRACE, sensor.level());
+
+	TEST_ASSERT_FALSE(Logger::configure_levels("wifi=off,mqtt=loud"));
+	TEST_ASSERT_FALSE(Logger::configure_levels("=off"));
+	TEST_ASSERT_FALSE(Logger::configure_levels("wifi=,mqtt=off"));
+	TEST_ASSERT_FALSE(Logger::configure_levels("wifi"));
+	TEST_ASSERT_EQUAL_INT(Level::INFO, wifi.level());
+	TEST_ASSERT_EQUAL_INT(Level::INFO, mqtt.level());
+
+	TEST_ASSERT_TRUE(Logger::configure_levels(""));
+	TEST_ASSERT_TRUE(Logger::configure_levels("unknown=off,*=all"));
+	TEST_ASSERT_EQUAL_INT(Level::ALL, wifi.level());
+}
+
+/*
+ * Reconfiguring many loggers must be fast.
+ */
+void test_many() {
+	static constexpr unsigned int LOGGERS = 500;
+	std::vector<std::string> names;
+	std::vector<std::unique_ptr<Logger>> loggers;
+
+	names.reserve(LOGGERS);
+	for (unsigned int i = 0; i < LOGGERS; i++) {
+		char name[16];
+
+		std::snprintf(name, sizeof(name), "module%03u.%s", i, i % 2 ? "rx" : "tx");
+		names.emplace_back(name);
+		loggers.emplace_back(new Logger{FPSTR(names.back().c_str())});
+		Logger::register_logger(loggers.back().get());
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	TEST_ASSERT_TRUE(Logger::configure_levels("*=info,*.rx=debug,module123.rx=trace,module4*=err"));
+	auto end = std::chrono::steady_clock::now();
+
+	TEST_ASSERT_EQUAL_INT(Level::INFO, loggers[0]->level());
+	TEST_ASSERT_EQUAL_INT(Level::DEBUG, loggers[1]->level());
+	TEST_ASSERT_EQUAL_INT(Level::TRACE, loggers[123]->level());
+	TEST_ASSERT_EQUAL_INT(Level::ERR, loggers[401]->level());
+	TEST_ASSERT_EQUAL_PTR(loggers[321].get(), Logger::find_logger("module321.rx"));
+
+	char text[128];
+
+	std::snprintf(text, sizeof(text), "Configured %u loggers in %lu µs", LOGGERS,
+		(unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+	TEST_MESSAGE(text);
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_find);
+	RUN_TEST(test_patterns);
+	RUN_TEST(test_specs);
+	RUN_TEST(test_many);
+
+	return UNITY_END();
+}
@@ -0,0 +1,326 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <uuid/log.h>
+
+using ::uuid::log::Facility;
+using ::uuid::log::Level;
+using ::uuid::log::MappedRingHandler;
+using ::uuid::log::MappedRingReader;
+using ::uuid::log::Message;
+using ::uuid::log::PrintHandler;
+
+class TestPrint: public Print {
+public:
+	TestPrint() = default;
+
+	size_t write(uint8_t c) override {
+		return write(&c, 1);
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		output_.append(reinterpret_cast<const char *>(buffer), size);
+		return size;
+	}
+
+	std::string output_;
+};
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<Message> message) override {
+		messages_.push_back(message);
+	}
+
+	std::vector<std::shared_ptr<Message>> messages_;
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return 0;
+}
+
+} // namespace uuid
+
+static std::string filename;
+
+static std::shared_ptr<Message> create_message(uint64_t uptime_ms, const char *text) {
+	return std::make_shared<Message>(uptime_ms, Level::INFO, Facility::DAEMON,
+		reinterpret_cast<const __FlashStringHelper *>("test"), text);
+}
+
+static void remove_file() {
+	::unlink(filename.c_str());
+}
+
+/*
+ * Messages must be recovered from the file in the order they were
+ * written, including after the file is reopened.
+ */
+void test_recover() {
+	remove_file();
+
+	{
+		MappedRingHandler handler;
+
+		TEST_ASSERT_FALSE(handler.is_open());
+		TEST_ASSERT_FALSE(handler.open(filename.c_str(), 1024));
+		TEST_ASSERT_TRUE(handler.open(filename.c_str(), 8192));
+		TEST_ASSERT_TRUE(handler.is_open());
+
+		handler << create_message(1, "Hello");
+		handler << std::make_shared<Message>(2, Level::TRACE, Facility::LOCAL7,
+			reinterpret_cast<const __FlashStringHelper *>("other"), "World");
+		handler << create_message(3, "");
+	}
+
+	{
+		MappedRingHandler handler;
+
+		TEST_ASSERT_TRUE(handler.open(filename.c_str(), 8192));
+		handler << create_message(4, "Again");
+	}
+
+	MappedRingReader reader;
+	Test test;
+
+	TEST_ASSERT_TRUE(reader.open(filename.c_str()));
+	TEST_ASSERT_EQUAL_INT(4, reader.size());
+	TEST_ASSERT_EQUAL_INT(4, reader.read(test));
+	TEST_ASSERT_EQUAL_INT(4, test.messages_.size());
+
+	TEST_ASSERT_EQUAL_UINT64(1, test.messages_[0]->uptime_ms);
+	TEST_ASSERT_EQUAL_INT(Level::INFO, test.messages_[0]->level);
+	TEST_ASSERT_EQUAL_INT(Facility::DAEMON, test.messages_[0]->facility);
+	TEST_ASSERT_EQUAL_STRING("test", reinterpret_cast<const char *>(test.messages_[0]->name));
+	TEST_ASSERT_EQUAL_STRING("Hello", test.messages_[0]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(Level::TRACE, test.messages_[1]->level);
+	TEST_ASSERT_EQUAL_INT(Facility::LOCAL7, test.messages_[1]->facility);
+	TEST_ASSERT_EQUAL_STRING("other", reinterpret_cast<const char *>(test.messages_[1]->name));
+	TEST_ASSERT_EQUAL_STRING("World", test.messages_[1]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("", test.messages_[2]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Again", test.messages_[3]->text.c_str());
+
+	Test last;
+
+	TEST_ASSERT_EQUAL_INT(2, reader.read(last, 2));
+	TEST_ASSERT_EQUAL_STRING("", last.messages_[0]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Again", last.messages_[1]->text.c_str());
+
+	/* A different size starts a new file */
+	{
+		MappedRingHandler handler;
+
+		TEST_ASSERT_TRUE(handler.open(filename.c_str(), 4096));
+	}
+
+	TEST_ASSERT_TRUE(reader.open(filename.c_str()));
+	TEST_ASSERT_EQUAL_INT(0, reader.size());
+}
+
+/*
+ * The oldest messages must be overwritten when the file is full.
+ */
+void test_wrap() {
+	static constexpr unsigned int MESSAGES = 1000;
+	MappedRingHandler handler;
+	MappedRingReader reader;
+	Test test;
+
+	remove_file();
+	TEST_ASSERT_TRUE(handler.open(filename.c_str(), 4096));
+
+	for (unsigned int i = 0; i < MESSAGES; i++) {
+		handler << create_message(i, std::string(i % 50, 'x').append(std::to_string(i)).c_str());
+	}
+
+	TEST_ASSERT_TRUE(reader.open(filename.c_str()));
+	TEST_ASSERT_GREATER_THAN(10, reader.size());
+	TEST_ASSERT_LESS_OR_EQUAL(100, reader.size());
+	reader.read(test);
+
+	for (size_t i = 0; i < test.messages_.size(); i++) {
+		uint64_t expected = MESSAGES - test.messages_.size() + i;
+
+		TEST_ASSERT_EQUAL_UINT64(expected, test.messages_[i]->uptime_ms);
+		TEST_ASSERT_EQUAL_STRING(std::string(expected % 50, 'x').append(std::to_string(expected)).c_str(),
+			test.messages_[i]->text.c_str());
+	}
+}
+
+/*
+ * Messages must be recovered after a crash, and records that were
+ * only partially written must be ignored.
+ */
+void test_crash() {
+	remove_file();
+
+	pid_t pid = ::fork();
+
+	if (pid == 0) {
+		MappedRingHandler handler;
+
+		if (handler.open(filename.c_str(), 4096)) {
+			for (unsigned int i = 0; i < 10; i++) {
+				handler << create_message(i, "Before crash");
+			}
+		}
+
+		::_exit(0);
+	}
+
+	int status = -1;
+
+	TEST_ASSERT_EQUAL_INT(pid, ::waitpid(pid, &status, 0));
+	TEST_ASSERT_EQUAL_INT(0, status);
+
+	MappedRingReader reader;
+
+	TEST_ASSERT_TRUE(reader.open(filename.c_str()));
+	TEST_ASSERT_EQUAL_INT(10, reader.size());
+
+	/* Corrupt the text of the second record */
+	int fd = ::open(filename.c_str(), O_WRONLY);
+	const size_t record_size = (32 + 4 + 12 + 7) & ~7;
+
+	TEST_ASSERT_TRUE(fd >= 0);
+	TEST_ASSERT_EQUAL_INT(1, ::pwrite(fd, "?", 1, 64 + record_size + 32 + 4));
+	::close(fd);
+
+	TEST_ASSERT_TRUE(reader.open(filename.c_str()));
+	TEST_ASSERT_EQUAL_INT(9, reader.size());
+
+	Test test;
+
+	reader.read(test);
+	TEST_ASSERT_EQUAL_UINT64(0, test.messages_[0]->uptime_ms);
+	TEST_ASSERT_EQUAL_UINT64(2, test.messages_[1]->uptime_ms);
+
+	/* New messages must continue after the last record */
+	{
+		MappedRingHandler handler;
+
+		TEST_ASSERT_TRUE(handler.open(filename.c_str(), 4096));
+		handler << create_message(10, "After crash");
+	}
+
+	Test after;
+
+	TEST_ASSERT_TRUE(reader.open(filename.c_str()));
+	TEST_ASSERT_EQUAL_INT(10, reader.read(after));
+	TEST_ASSERT_EQUAL_STRING("After crash", after.messages_.back()->text.c_str());
+}
+
+/*
+ * Recovered messages must be output in the same format as
+ * PrintHandler.
+ */
+void test_print() {
+	MappedRingReader reader;
+	TestPrint print;
+	PrintHandler print_handler{print};
+
+	remove_file();
+
+	{
+		MappedRingHandler handler;
+
+		TEST_ASSERT_TRUE(handler.open(filename.c_str(), 4096));
+		handler << create_message(86400000 + 3723004, "Hello, World!");
+		handler.sync();
+	}
+
+	TEST_ASSERT_TRUE(reader.open(filename.c_str()));
+	reader.read(print_handler);
+	print_handler.loop();
+
+	TEST_ASSERT_EQUAL_STRING("001+01:02:03.004 I [test] Hello, World!\r\n", print.output_.c_str());
+}
+
+/*
+ * Messages that can't be allocated from an exhausted pool must not be
+ * passed to the handler or counted as recovered.
+ */
+void test_pool_exhausted() {
+	using uuid::log::MessagePool;
+	MappedRingReader reader;
+	TestPrint print;
+	PrintHandler print_handler{print};
+
+	remove_file();
+
+	{
+		MappedRingHandler handler;
+
+		TEST_ASSERT_TRUE(handler.open(filename.c_str(), 4096));
+		handler << create_message(1, "One");
+		handler << create_message(2, "Two");
+		handler << create_message(3, "Three");
+		handler.sync();
+	}
+
+	TEST_ASSERT_TRUE(reader.open(filename.c_str()));
+	TEST_ASSERT_EQUAL_INT(3, reader.size());
+
+	TEST_ASSERT_TRUE(MessagePool::configure(1, MessagePool::Policy::DROP, 16));
+	TEST_ASSERT_EQUAL_INT(1, reader.read(print_handler));
+	print_handler.loop();
+	TEST_ASSERT_TRUE(MessagePool::configure(0));
+
+	TEST_ASSERT_EQUAL_STRING("000+00:00:00.001 I [test] One\r\n", print.output_.c_str());
+}
+
+int main(int argc, char *argv[]) {
+	char name[] = "/tmp/uuid-log-test-XXXXXX";
+	int fd = ::mkstemp(name);
+
+	if (fd < 0) {
+		return 1;
+	}
+	::close(fd);
+	filename = name;
+
+	UNITY_BEGIN();
+	RUN_TEST(test_recover);
+	RUN_TEST(test_wrap);
+	RUN_TEST(test_crash);
+	RUN_TEST(test_print);
+	RUN_TEST(test_pool_exhausted);
+
+	remove_file();
+	return UNITY_END();
+}
@@ -0,0 +1,166 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#if UUID_LOG_THREAD_SAFE
+# include <thread>
+#endif
+#include <vector>
+
+#include <uuid/log.h>
+
+#if UUID_LOG_THREAD_SAFE
+static constexpr unsigned int THREADS = 4;
+#else
+static constexpr unsigned int THREADS = 1;
+#endif
+static constexpr unsigned int MESSAGES = 5000;
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	/*
+	 * Each thread logs its own messages in order, so the message must
+	 * be the next one for that thread unless its slot was corrupted.
+	 */
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		unsigned int thread;
+
+		if (!valid(*message, thread)) {
+			errors_++;
+			return;
+		}
+
+#if UUID_LOG_THREAD_SAFE
+		std::this_thread::yield();
+#endif
+
+		if (!valid(*message, thread)) {
+			errors_++;
+			return;
+		}
+
+		next_[thread]++;
+	}
+
+	bool valid(const uuid::log::Message &message, unsigned int &thread) {
+		unsigned int number;
+
+		return std::sscanf(message.text.c_str(), "Thread %u message %u", &thread, &number) == 2
+			&& thread < THREADS && number == next_[thread];
+	}
+
+	std::array<unsigned int, THREADS> next_{};
+	std::atomic<unsigned long> errors_{0};
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static std::atomic<uint64_t> millis{0};
+	return ++millis;
+}
+
+} // namespace uuid
+
+/*
+ * Slots must only be used by one message at a time when messages are
+ * allocated and released concurrently, and they must all be available
+ * again afterwards.
+ */
+void test_concurrent() {
+	using uuid::log::MessagePool;
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	const unsigned long pool_before = MessagePool::pool_allocations();
+	const unsigned long heap_before = MessagePool::heap_allocations();
+	auto run = [&logger] (unsigned int thread) {
+		for (unsigned int i = 0; i < MESSAGES; i++) {
+			logger.info("Thread %u message %u", thread, i);
+		}
+	};
+
+	TEST_ASSERT_TRUE(MessagePool::configure(2, MessagePool::Policy::HEAP, 32));
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+
+#if UUID_LOG_THREAD_SAFE
+	std::vector<std::thread> threads;
+
+	for (unsigned int i = 0; i < THREADS; i++) {
+		threads.emplace_back(run, i);
+	}
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+#else
+	run(0);
+#endif
+
+	TEST_ASSERT_EQUAL_UINT(0, test.errors_.load());
+
+	for (unsigned int i = 0; i < THREADS; i++) {
+		TEST_ASSERT_EQUAL_UINT(MESSAGES, test.next_[i]);
+	}
+
+	TEST_ASSERT_EQUAL_UINT(THREADS * MESSAGES, (MessagePool::pool_allocations() - pool_before) + (MessagePool::heap_allocations() - heap_before));
+	TEST_ASSERT_GREATER_THAN(0, MessagePool::pool_allocations() - pool_before);
+	TEST_ASSERT_EQUAL_INT(2, MessagePool::available());
+
+	uuid::log::Logger::unregister_handler(&test);
+	TEST_ASSERT_TRUE(MessagePool::configure(0));
+	TEST_ASSERT_EQUAL_INT(0, MessagePool::count());
+}
+
+/*
+ * Messages must still be allocated from the heap when the pool is not
+ * configured, without being counted as pool or heap allocations.
+ */
+void test_unconfigured() {
+	using uuid::log::MessagePool;
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+	const unsigned long pool_before = MessagePool::pool_allocations();
+	const unsigned long heap_before = MessagePool::heap_allocations();
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+	logger.info("Thread %u message %u", 0, 0);
+
+	TEST_ASSERT_EQUAL_UINT(0, test.errors_.load());
+	TEST_ASSERT_EQUAL_UINT(1, test.next_[0]);
+	TEST_ASSERT_EQUAL_UINT(pool_before, MessagePool::pool_allocations());
+	TEST_ASSERT_EQUAL_UINT(heap_before, MessagePool::heap_allocations());
+	TEST_ASSERT_EQUAL_INT(0, MessagePool::available());
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_unconfigured);
+	RUN_TEST(test_concurrent);
+	return UNITY_END();
+}
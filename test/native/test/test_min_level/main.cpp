@@ -0,0 +1,141 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <memory>
+#include <string>
+
+#include <uuid/log.h>
+
+/* Built in its own environment with -DUUID_LOG_MIN_LEVEL=INFO. */
+static_assert(uuid::log::min_level == uuid::log::Level::INFO, "Minimum log level must be INFO");
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		message_ = message;
+		count_++;
+	}
+
+	std::shared_ptr<uuid::log::Message> message_;
+	unsigned int count_ = 0;
+};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static uint64_t millis = 0;
+	return ++millis;
+}
+
+} // namespace uuid
+
+static unsigned int evaluated = 0;
+
+static unsigned int side_effect() {
+	return ++evaluated;
+}
+
+/*
+ * Messages below the minimum level must not be logged by the macros
+ * and their arguments must not be evaluated, even when a handler and
+ * the logger are interested in them.
+ */
+void test_macros() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	evaluated = 0;
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	UUID_LOG_DEBUG(logger, "%u", side_effect());
+	UUID_LOG_TRACE(logger, "%u", side_effect());
+	TEST_ASSERT_EQUAL_UINT_MESSAGE(0, evaluated, "Arguments must not be evaluated");
+	TEST_ASSERT_EQUAL_UINT_MESSAGE(0, test.count_, "Messages must not be dispatched");
+
+	UUID_LOG_INFO(logger, "%u", side_effect());
+	TEST_ASSERT_EQUAL_UINT(1, evaluated);
+	TEST_ASSERT_EQUAL_UINT(1, test.count_);
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::INFO, test.message_->level);
+	TEST_ASSERT_EQUAL_STRING("1", test.message_->text.c_str());
+
+	UUID_LOG_EMERG(logger, "%u", side_effect());
+	TEST_ASSERT_EQUAL_UINT(2, evaluated);
+	TEST_ASSERT_EQUAL_UINT(2, test.count_);
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::EMERG, test.message_->level);
+}
+
+/*
+ * Messages below the minimum level must not be logged by the sampling
+ * and call site macros either.
+ */
+void test_sites() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	evaluated = 0;
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	UUID_LOG_EVERY_N(logger, DEBUG, 1, "%u", side_effect());
+	UUID_LOG_EVERY_MS(logger, DEBUG, 0, "%u", side_effect());
+	UUID_LOG_SITE(logger, DEBUG, "%u", side_effect());
+	TEST_ASSERT_EQUAL_UINT_MESSAGE(0, evaluated, "Arguments must not be evaluated");
+	TEST_ASSERT_EQUAL_UINT_MESSAGE(0, test.count_, "Messages must not be dispatched");
+
+	UUID_LOG_SITE(logger, INFO, "%u", side_effect());
+	TEST_ASSERT_EQUAL_UINT(1, evaluated);
+	TEST_ASSERT_EQUAL_UINT(1, test.count_);
+}
+
+/*
+ * Levels below the minimum level must never be enabled, even when they
+ * are logged without using the macros.
+ */
+void test_functions() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	TEST_ASSERT_TRUE(logger.enabled(uuid::log::Level::INFO));
+	TEST_ASSERT_FALSE(logger.enabled(uuid::log::Level::DEBUG));
+	TEST_ASSERT_FALSE(logger.enabled(uuid::log::Level::TRACE));
+
+	logger.debug("Hello, World!");
+	logger.log(uuid::log::Level::TRACE, "Hello, World!");
+	logger.logd(uuid::log::Level::DEBUG, "Hello, %u World!", 42);
+	TEST_ASSERT_EQUAL_UINT(0, test.count_);
+
+	logger.info("Hello, World!");
+	TEST_ASSERT_EQUAL_UINT(1, test.count_);
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_macros);
+	RUN_TEST(test_sites);
+	RUN_TEST(test_functions);
+	return UNITY_END();
+}
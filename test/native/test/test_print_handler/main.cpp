@@ -0,0 +1,529 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uuid/log.h>
+
+using uuid::log::Message;
+using uuid::log::PrintHandler;
+
+class TestPrint: public Print {
+public:
+	TestPrint() = default;
+
+	size_t write(uint8_t c) override {
+		return write(&c, 1);
+	}
+
+	size_t write(const uint8_t *buffer, size_t size) override {
+		output_.append(reinterpret_cast<const char *>(buffer), size);
+		writes_++;
+
+		if (delay_.count() > 0) {
+			auto end = std::chrono::steady_clock::now() + delay_;
+
+			while (std::chrono::steady_clock::now() < end);
+		}
+
+		if (hold_) {
+			auto end = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+
+			held_ = true;
+			while (*hold_ && std::chrono::steady_clock::now() < end) {
+				std::this_thread::yield();
+			}
+			hold_timeout_ = *hold_;
+			hold_ = nullptr;
+		}
+
+		return size;
+	}
+
+	std::string output_;
+	size_t writes_ = 0;
+	std::chrono::microseconds delay_{0};
+	std::atomic<unsigned int> *hold_ = nullptr; /* Block the next write until this is zero */
+	std::atomic<bool> held_{false};
+	bool hold_timeout_ = false;
+};
+
+static size_t count_lines(const std::string &output) {
+	size_t count = 0;
+
+	for (size_t pos = 0; (pos = output.find("\r\n", pos)) != std::string::npos; pos += 2) {
+		count++;
+	}
+	return count;
+}
+
+static uint64_t now_ms = 0;
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return now_ms;
+}
+
+} // namespace uuid
+
+static std::shared_ptr<Message> create_message(uint64_t uptime_ms, const char *text) {
+	return std::make_shared<Message>(uptime_ms, uuid::log::Level::INFO,
+		uuid::log::Facility::LOCAL0,
+		reinterpret_cast<const __FlashStringHelper *>("test"), text);
+}
+
+static void test_queue(bool lock_free) {
+	TestPrint print;
+	PrintHandler handler{print, lock_free};
+
+	handler.maximum_log_messages(4);
+	TEST_ASSERT_EQUAL_INT(4, handler.maximum_log_messages());
+
+	for (unsigned int i = 1; i <= 6; i++) {
+		handler << create_message(i, std::to_string(i).c_str());
+	}
+
+	handler.loop(1);
+	TEST_ASSERT_EQUAL_STRING("000+00:00:00.003 I [test] 3\r\n", print.output_.c_str());
+
+	print.output_.clear();
+	handler.loop();
+	TEST_ASSERT_EQUAL_STRING(
+		"000+00:00:00.004 I [test] 4\r\n"
+		"000+00:00:00.005 I [test] 5\r\n"
+		"000+00:00:00.006 I [test] 6\r\n", print.output_.c_str());
+
+	print.output_.clear();
+	handler.loop();
+	TEST_ASSERT_EQUAL_STRING("", print.output_.c_str());
+
+	for (unsigned int i = 7; i <= 9; i++) {
+		handler << create_message(i, std::to_string(i).c_str());
+	}
+
+	handler.maximum_log_messages(2);
+
+	handler.loop();
+	TEST_ASSERT_EQUAL_STRING(
+		"000+00:00:00.008 I [test] 8\r\n"
+		"000+00:00:00.009 I [test] 9\r\n", print.output_.c_str());
+
+	for (unsigned int i = 10; i <= 12; i++) {
+		handler << create_message(i, std::to_string(i).c_str());
+	}
+
+	handler.maximum_log_messages(8);
+
+	for (unsigned int i = 13; i <= 14; i++) {
+		handler << create_message(i, std::to_string(i).c_str());
+	}
+
+	print.output_.clear();
+	handler.loop();
+	TEST_ASSERT_EQUAL_STRING(
+		"000+00:00:00.011 I [test] 11\r\n"
+		"000+00:00:00.012 I [test] 12\r\n"
+		"000+00:00:00.013 I [test] 13\r\n"
+		"000+00:00:00.014 I [test] 14\r\n", print.output_.c_str());
+}
+
+/*
+ * Messages must be output in order with the oldest discarded first.
+ */
+void test_locked() {
+	test_queue(false);
+}
+
+/*
+ * The lock-free queue must behave in the same way when the maximum
+ * number of messages is a power of 2.
+ */
+void test_lock_free() {
+	test_queue(true);
+}
+
+/*
+ * Messages added concurrently by multiple threads while loop() is
+ * running must be output in the order they were added by each thread,
+ * without duplicates.
+ */
+void test_lock_free_threads() {
+	static constexpr unsigned int PRODUCERS = 4;
+	static constexpr unsigned int MESSAGES = 20000;
+	TestPrint print;
+	PrintHandler handler{print, true};
+	std::atomic<unsigned int> running{PRODUCERS};
+	std::vector<std::thread> producers;
+
+	handler.maximum_log_messages(16);
+
+	for (unsigned int producer = 0; producer < PRODUCERS; producer++) {
+		producers.emplace_back([&handler, &running, producer] {
+			for (unsigned int i = 1; i <= MESSAGES; i++) {
+				handler << create_message(1, (std::to_string(producer) + " " + std::to_string(i)).c_str());
+			}
+			running--;
+		});
+	}
+
+	while (running) {
+		handler.loop(1);
+	}
+
+	for (auto &producer : producers) {
+		producer.join();
+	}
+
+	handler.loop();
+
+	std::vector<unsigned int> last(PRODUCERS);
+	size_t lines = 0;
+	size_t pos = 0;
+
+	while (pos < print.output_.size()) {
+		size_t end = print.output_.find("\r\n", pos);
+		unsigned int producer, i;
+
+		TEST_ASSERT_TRUE(end != std::string::npos);
+		TEST_ASSERT_EQUAL_INT(2, std::sscanf(print.output_.c_str() + pos, "000+00:00:00.001 I [test] %u %u", &producer, &i));
+		TEST_ASSERT_TRUE(producer < PRODUCERS);
+		TEST_ASSERT_TRUE_MESSAGE(i > last[producer], "Messages from each producer must be in order without duplicates");
+
+		last[producer] = i;
+		lines++;
+		pos = end + 2;
+	}
+
+	TEST_ASSERT_TRUE(lines > 0);
+	TEST_ASSERT_LESS_OR_EQUAL(PRODUCERS * MESSAGES, lines);
+	TEST_ASSERT_TRUE_MESSAGE(std::find(last.begin(), last.end(), MESSAGES) != last.end(), "Last message must be output");
+}
+
+/*
+ * The maximum number of messages must be the actual capacity of the
+ * lock-free queue.
+ */
+void test_lock_free_capacity() {
+	TestPrint print;
+	PrintHandler handler{print, true};
+
+	TEST_ASSERT_EQUAL_INT(64, handler.maximum_log_messages());
+
+	handler.maximum_log_messages(10);
+	TEST_ASSERT_EQUAL_INT(16, handler.maximum_log_messages());
+
+	for (unsigned int i = 1; i <= 20; i++) {
+		handler << create_message(i, std::to_string(i).c_str());
+	}
+
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(16, count_lines(print.output_));
+}
+
+/*
+ * The lock-free queue must be able to be resized while multiple threads
+ * are adding messages.
+ */
+void test_lock_free_resize() {
+	static constexpr unsigned int PRODUCERS = 4;
+	static constexpr unsigned int MESSAGES = 5000;
+	TestPrint print;
+	PrintHandler handler{print, true};
+	std::atomic<unsigned int> running{PRODUCERS};
+	std::vector<std::thread> producers;
+	unsigned int resizes = 0;
+
+	for (unsigned int producer = 0; producer < PRODUCERS; producer++) {
+		producers.emplace_back([&handler, &running, producer] {
+			for (unsigned int i = 1; i <= MESSAGES; i++) {
+				handler << create_message(1, (std::to_string(producer) + " " + std::to_string(i)).c_str());
+			}
+			running--;
+		});
+	}
+
+	while (running) {
+		handler.maximum_log_messages((resizes++ % 2) ? 8 : 32);
+		handler.loop(4);
+	}
+
+	for (auto &producer : producers) {
+		producer.join();
+	}
+
+	handler.loop();
+	print.output_.clear();
+
+	for (unsigned int producer = 0; producer < PRODUCERS; producer++) {
+		handler << create_message(1, (std::to_string(producer) + " " + std::to_string(MESSAGES + 1)).c_str());
+	}
+
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(PRODUCERS, count_lines(print.output_));
+	TEST_ASSERT_TRUE(resizes > 0);
+}
+
+/*
+ * Each message must be output with a single write.
+ */
+void test_writes() {
+	static constexpr unsigned int MESSAGES = 100;
+	TestPrint print;
+	PrintHandler handler{print};
+
+	handler.maximum_log_messages(MESSAGES);
+
+	for (unsigned int i = 0; i < MESSAGES; i++) {
+		handler << create_message(86400000UL + i, "Hello, World!");
+	}
+
+	handler.loop();
+
+	TEST_ASSERT_EQUAL_INT(MESSAGES, print.writes_);
+	TEST_ASSERT_EQUAL_INT(MESSAGES * std::strlen("001+00:00:00.000 I [test] Hello, World!\r\n"), print.output_.size());
+	TEST_ASSERT_EQUAL_STRING_LEN("001+00:00:00.000 I [test] Hello, World!\r\n", print.output_.c_str(), print.output_.size() / MESSAGES);
+
+	char text[128];
+
+	std::snprintf(text, sizeof(text), "%.1f writes and %.1f bytes per message",
+		(double)print.writes_ / MESSAGES, (double)print.output_.size() / MESSAGES);
+	TEST_MESSAGE(text);
+}
+
+/*
+ * Multiple messages must be combined into a single write up to the
+ * maximum size.
+ */
+void test_maximum_write_size() {
+	static constexpr unsigned int MESSAGES = 10;
+	TestPrint print;
+	PrintHandler handler{print};
+	std::string expected;
+
+	handler.maximum_log_messages(MESSAGES);
+	handler.maximum_write_size(100);
+	TEST_ASSERT_EQUAL_INT(100, handler.maximum_write_size());
+
+	for (unsigned int i = 0; i < MESSAGES; i++) {
+		handler << create_message(86400000UL + i, "Hello, World!");
+		expected += "001+00:00:00.00" + std::to_string(i) + " I [test] Hello, World!\r\n";
+	}
+
+	handler.loop(3);
+	TEST_ASSERT_EQUAL_INT(2, print.writes_);
+	TEST_ASSERT_EQUAL_INT(3 * 41, print.output_.size());
+
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(2 + 4, print.writes_);
+	TEST_ASSERT_EQUAL_STRING(expected.c_str(), print.output_.c_str());
+
+	print.writes_ = 0;
+	print.output_.clear();
+	handler << create_message(1, "Hello, World!");
+	handler << create_message(2, std::string(100, 'x').c_str());
+	handler << create_message(3, "Hello, World!");
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(3, print.writes_);
+	TEST_ASSERT_EQUAL_INT(41 + 128 + 41, print.output_.size());
+}
+
+/*
+ * Consecutive duplicate messages must be counted instead of being
+ * queued.
+ */
+void test_suppress_duplicates() {
+	TestPrint print;
+	PrintHandler handler{print};
+
+	TEST_ASSERT_FALSE(handler.suppress_duplicates());
+	handler.suppress_duplicates(true);
+	TEST_ASSERT_TRUE(handler.suppress_duplicates());
+
+	now_ms = 1000;
+	handler << create_message(1, "Error");
+	for (unsigned int i = 2; i <= 100; i++) {
+		handler << create_message(i, "Error");
+	}
+	handler << create_message(101, "OK");
+	handler << create_message(102, "OK");
+	handler.loop();
+
+	TEST_ASSERT_EQUAL_STRING(
+		"000+00:00:00.001 I [test] Error\r\n"
+		"000+00:00:00.100 I [test] last message repeated 99 times\r\n"
+		"000+00:00:00.101 I [test] OK\r\n", print.output_.c_str());
+
+	print.output_.clear();
+	now_ms = 102 + PrintHandler::REPEATED_MESSAGES_INTERVAL_MS - 1;
+	handler.loop();
+	TEST_ASSERT_EQUAL_STRING("", print.output_.c_str());
+
+	now_ms = 102 + PrintHandler::REPEATED_MESSAGES_INTERVAL_MS;
+	handler.loop();
+	TEST_ASSERT_EQUAL_STRING("000+00:00:00.102 I [test] last message repeated 1 times\r\n", print.output_.c_str());
+
+	print.output_.clear();
+	handler << create_message(103, "OK");
+	handler << create_message(104, "OK");
+	handler.suppress_duplicates(false);
+	handler << create_message(105, "OK");
+	handler.loop();
+	TEST_ASSERT_EQUAL_STRING(
+		"000+00:00:00.104 I [test] last message repeated 2 times\r\n"
+		"000+00:00:00.105 I [test] OK\r\n", print.output_.c_str());
+}
+
+static void benchmark(bool lock_free) {
+	static constexpr unsigned int PRODUCERS = 4;
+	static constexpr unsigned int MESSAGES = 20000;
+	TestPrint print;
+	PrintHandler handler{print, lock_free};
+	std::atomic<unsigned int> running{PRODUCERS};
+	std::vector<std::thread> producers;
+	std::vector<std::chrono::nanoseconds> worst(PRODUCERS);
+	auto start = std::chrono::steady_clock::now();
+
+	handler.maximum_log_messages(PRODUCERS * MESSAGES);
+	print.delay_ = std::chrono::microseconds{2};
+
+	for (unsigned int producer = 0; producer < PRODUCERS; producer++) {
+		producers.emplace_back([&handler, &running, &worst, producer] {
+			auto message = create_message(1, "benchmark");
+
+			for (unsigned int i = 1; i <= MESSAGES; i++) {
+				auto before = std::chrono::steady_clock::now();
+
+				handler << message;
+
+				worst[producer] = std::max(worst[producer], std::chrono::steady_clock::now() - before);
+			}
+			running--;
+		});
+	}
+
+	while (running) {
+		handler.loop(1);
+	}
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	for (auto &producer : producers) {
+		producer.join();
+	}
+
+	handler.loop();
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(PRODUCERS * MESSAGES, count_lines(print.output_), "No messages must be dropped when the queue is large enough");
+
+	char text[128];
+
+	std::snprintf(text, sizeof(text), "%s: %u messages from %u threads in %lldus, worst case %lldus",
+		lock_free ? "lock-free" : "locked", PRODUCERS * MESSAGES, PRODUCERS,
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(),
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(*std::max_element(worst.begin(), worst.end())).count());
+	TEST_MESSAGE(text);
+}
+
+/*
+ * Compare the time taken by producers to add messages while loop() is
+ * writing to a slow destination. All of the messages must be output.
+ */
+void test_benchmark() {
+#if UUID_LOG_THREAD_SAFE
+	benchmark(false);
+#endif
+	benchmark(true);
+}
+
+static void test_producers(bool lock_free) {
+	static constexpr unsigned int PRODUCERS = 4;
+	static constexpr unsigned int MESSAGES = 1000;
+	TestPrint print;
+	PrintHandler handler{print, lock_free};
+	std::atomic<unsigned int> running{PRODUCERS};
+	std::vector<std::thread> producers;
+
+	handler.maximum_log_messages(1 + PRODUCERS * MESSAGES);
+	handler << create_message(1, "first");
+	print.hold_ = &running;
+
+	std::thread consumer{[&handler] { handler.loop(); }};
+
+	while (!print.held_) {
+		std::this_thread::yield();
+	}
+
+	for (unsigned int producer = 0; producer < PRODUCERS; producer++) {
+		producers.emplace_back([&handler, &running] {
+			auto message = create_message(1, "producer");
+
+			for (unsigned int i = 1; i <= MESSAGES; i++) {
+				handler << message;
+			}
+			running--;
+		});
+	}
+
+	for (auto &producer : producers) {
+		producer.join();
+	}
+	consumer.join();
+
+	TEST_ASSERT_FALSE_MESSAGE(print.hold_timeout_, "Producers must not wait for loop() to finish writing");
+
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(1 + PRODUCERS * MESSAGES, count_lines(print.output_));
+}
+
+/*
+ * Producers must be able to add messages while loop() is blocked
+ * writing to the destination.
+ */
+void test_producers_not_blocked() {
+#if UUID_LOG_THREAD_SAFE
+	test_producers(false);
+#endif
+	test_producers(true);
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_locked);
+	RUN_TEST(test_lock_free);
+	RUN_TEST(test_lock_free_threads);
+	RUN_TEST(test_lock_free_capacity);
+	RUN_TEST(test_lock_free_resize);
+	RUN_TEST(test_writes);
+	RUN_TEST(test_maximum_write_size);
+	RUN_TEST(test_suppress_duplicates);
+	RUN_TEST(test_benchmark);
+	RUN_TEST(test_producers_not_blocked);
+	return UNITY_END();
+}
@@ -0,0 +1,164 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <memory>
+#include <vector>
+
+#include <uuid/log.h>
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		messages_.push_back(message);
+	}
+
+	std::vector<std::shared_ptr<uuid::log::Message>> messages_;
+};
+
+static uint64_t now_ms = 1000;
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return now_ms;
+}
+
+} // namespace uuid
+
+/*
+ * Messages beyond the burst size must be discarded until tokens are
+ * available again, and then the number of discarded messages must be
+ * logged once.
+ */
+void test_rate_limit() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+	logger.rate_limit(10, 3);
+
+	for (unsigned int i = 1; i <= 5; i++) {
+		logger.warning("Hello %u", i);
+	}
+
+	TEST_ASSERT_EQUAL_INT(3, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Hello 3", test.messages_[2]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(2, logger.suppressed_messages());
+
+	now_ms += 50;
+	logger.logp(uuid::log::Level::WARNING, "Hello 6");
+	TEST_ASSERT_EQUAL_INT(3, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(3, logger.suppressed_messages());
+
+	now_ms += 50;
+	logger.warning("Hello %u", 7);
+	TEST_ASSERT_EQUAL_INT(5, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Suppressed 3 messages", test.messages_[3]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::WARNING, test.messages_[3]->level);
+	TEST_ASSERT_EQUAL_STRING("Hello 7", test.messages_[4]->text.c_str());
+
+	now_ms += 100;
+	logger.warning("Hello %u", 8);
+	TEST_ASSERT_EQUAL_INT(6, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Hello 8", test.messages_[5]->text.c_str());
+
+	now_ms += 60000;
+	for (unsigned int i = 9; i <= 12; i++) {
+		logger.info("Hello %u", i);
+	}
+	TEST_ASSERT_EQUAL_INT(9, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(4, logger.suppressed_messages());
+
+	logger.rate_limit(0, 0);
+	for (unsigned int i = 13; i <= 20; i++) {
+		logger.info("Hello %u", i);
+	}
+	TEST_ASSERT_EQUAL_INT(17, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Hello 20", test.messages_[16]->text.c_str());
+}
+
+/*
+ * Loggers without a rate limit and disabled messages must not be
+ * limited or counted.
+ */
+void test_disabled() {
+	Test test;
+	uuid::log::Logger logger1{F("test1"), uuid::log::Facility::LOCAL0};
+	uuid::log::Logger logger2{F("test2"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::INFO);
+	logger1.rate_limit(1, 1);
+
+	for (unsigned int i = 1; i <= 5; i++) {
+		logger1.debug("Hello %u", i);
+		logger2.info("Hello %u", i);
+	}
+
+	TEST_ASSERT_EQUAL_INT(5, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(0, logger1.suppressed_messages());
+	TEST_ASSERT_EQUAL_INT(0, logger2.suppressed_messages());
+
+	logger1.info("Hello %u", 6);
+	logger1.info("Hello %u", 7);
+	TEST_ASSERT_EQUAL_INT(6, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(1, logger1.suppressed_messages());
+}
+
+/*
+ * The number of discarded messages must be logged with the facility of
+ * the message that is allowed, so that it goes to the same handlers.
+ */
+void test_facility() {
+	Test all;
+	Test daemon;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&all, uuid::log::Level::ALL);
+	uuid::log::Logger::register_handler(&daemon, uuid::log::Level::ALL, uuid::log::facility_mask(uuid::log::Facility::DAEMON));
+	logger.rate_limit(1, 1);
+
+	logger.log(uuid::log::Level::NOTICE, uuid::log::Facility::DAEMON, "Hello %u", 1);
+	logger.log(uuid::log::Level::NOTICE, uuid::log::Facility::DAEMON, "Hello %u", 2);
+	TEST_ASSERT_EQUAL_INT(1, daemon.messages_.size());
+	TEST_ASSERT_EQUAL_INT(1, logger.suppressed_messages());
+
+	now_ms += 1000;
+	logger.log(uuid::log::Level::NOTICE, uuid::log::Facility::DAEMON, "Hello %u", 3);
+	TEST_ASSERT_EQUAL_INT(3, daemon.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Suppressed 1 messages", daemon.messages_[1]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Facility::DAEMON, daemon.messages_[1]->facility);
+	TEST_ASSERT_EQUAL_STRING("Hello 3", daemon.messages_[2]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(3, all.messages_.size());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Facility::DAEMON, all.messages_[1]->facility);
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_rate_limit);
+	RUN_TEST(test_disabled);
+	RUN_TEST(test_facility);
+	return UNITY_END();
+}
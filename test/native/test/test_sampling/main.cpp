@@ -0,0 +1,132 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <memory>
+#include <vector>
+
+#include <uuid/log.h>
+
+class Test: public uuid::log::Handler {
+public:
+	Test() = default;
+	~Test() override {
+		uuid::log::Logger::unregister_handler(this);
+	}
+
+	void operator<<(std::shared_ptr<uuid::log::Message> message) override {
+		messages_.push_back(message);
+	}
+
+	std::vector<std::shared_ptr<uuid::log::Message>> messages_;
+};
+
+static uint64_t now_ms = 1000;
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return now_ms;
+}
+
+} // namespace uuid
+
+static unsigned int evaluated = 0;
+
+static unsigned int evaluate(unsigned int value) {
+	evaluated++;
+	return value;
+}
+
+/*
+ * Only 1 in N messages must be logged for each call site, and the
+ * arguments of other messages must not be evaluated.
+ */
+void test_every_n() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+	evaluated = 0;
+
+	for (unsigned int i = 1; i <= 10; i++) {
+		UUID_LOG_EVERY_N(logger, TRACE, 3, "Hello %u", evaluate(i));
+		UUID_LOG_EVERY_N(logger, DEBUG, 5, "World %u", evaluate(i));
+	}
+
+	TEST_ASSERT_EQUAL_INT(6, test.messages_.size());
+	TEST_ASSERT_EQUAL_INT(6, evaluated);
+	TEST_ASSERT_EQUAL_STRING("Hello 1", test.messages_[0]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::TRACE, test.messages_[0]->level);
+	TEST_ASSERT_EQUAL_STRING("World 1", test.messages_[1]->text.c_str());
+	TEST_ASSERT_EQUAL_INT(uuid::log::Level::DEBUG, test.messages_[1]->level);
+	TEST_ASSERT_EQUAL_STRING("Hello 4", test.messages_[2]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("World 6", test.messages_[3]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello 7", test.messages_[4]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello 10", test.messages_[5]->text.c_str());
+}
+
+/*
+ * At most one message must be logged during each interval for each
+ * call site.
+ */
+void test_every_ms() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	for (unsigned int i = 1; i <= 25; i++) {
+		UUID_LOG_EVERY_MS(logger, TRACE, 100, "Hello %u", i);
+		now_ms += 10;
+	}
+
+	TEST_ASSERT_EQUAL_INT(3, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Hello 1", test.messages_[0]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello 11", test.messages_[1]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello 21", test.messages_[2]->text.c_str());
+}
+
+/*
+ * Messages at a disabled level must not be counted.
+ */
+void test_disabled() {
+	Test test;
+	uuid::log::Logger logger{F("test"), uuid::log::Facility::LOCAL0};
+
+	uuid::log::Logger::register_handler(&test, uuid::log::Level::ALL);
+
+	for (unsigned int i = 1; i <= 6; i++) {
+		logger.level(i <= 2 ? uuid::log::Level::INFO : uuid::log::Level::ALL);
+		UUID_LOG_EVERY_N(logger, TRACE, 2, "Hello %u", i);
+	}
+
+	TEST_ASSERT_EQUAL_INT(2, test.messages_.size());
+	TEST_ASSERT_EQUAL_STRING("Hello 3", test.messages_[0]->text.c_str());
+	TEST_ASSERT_EQUAL_STRING("Hello 5", test.messages_[1]->text.c_str());
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_every_n);
+	RUN_TEST(test_every_ms);
+	RUN_TEST(test_disabled);
+	return UNITY_END();
+}
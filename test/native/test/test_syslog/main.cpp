@@ -0,0 +1,408 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#if UUID_LOG_THREAD_SAFE
+# include <thread>
+#endif
+#include <vector>
+
+#include <uuid/log.h>
+
+using ::uuid::log::Facility;
+using ::uuid::log::Level;
+using ::uuid::log::Message;
+using ::uuid::log::SyslogHandler;
+
+static std::atomic<uint64_t> now_ms{1000};
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	return now_ms;
+}
+
+} // namespace uuid
+
+static std::shared_ptr<Message> create_message(Level level, Facility facility, const char *name, const char *text) {
+	return std::make_shared<Message>(1000, level, facility,
+		reinterpret_cast<const __FlashStringHelper *>(name), text);
+}
+
+/* Create a socket listening on an unused local port */
+static int listen_socket(int type, uint16_t &port) {
+	struct sockaddr_in address{};
+	socklen_t length = sizeof(address);
+	struct timeval timeout{};
+	int fd = ::socket(AF_INET, type, 0);
+
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	timeout.tv_sec = 5;
+
+	TEST_ASSERT_TRUE(fd >= 0);
+	TEST_ASSERT_EQUAL_INT(0, ::bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+	TEST_ASSERT_EQUAL_INT(0, ::getsockname(fd, reinterpret_cast<struct sockaddr *>(&address), &length));
+	TEST_ASSERT_EQUAL_INT(0, ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)));
+
+	if (type == SOCK_STREAM) {
+		TEST_ASSERT_EQUAL_INT(0, ::listen(fd, 1));
+	}
+
+	port = ntohs(address.sin_port);
+	return fd;
+}
+
+static std::string receive(int fd) {
+	char buffer[2048];
+	ssize_t length = ::recv(fd, buffer, sizeof(buffer), 0);
+
+	return length > 0 ? std::string(buffer, length) : std::string();
+}
+
+/* Check the format of a timestamp and remove it */
+static std::string remove_timestamp(const std::string &text, size_t pos, bool rfc5424) {
+	const char *format = rfc5424 ? "0000-00-00T00:00:00.000Z" : "Mmm 00 00:00:00";
+	const size_t length = std::strlen(format);
+
+	TEST_ASSERT_TRUE(text.length() >= pos + length);
+
+	for (size_t i = 0; i < length; i++) {
+		char c = text[pos + i];
+
+		switch (format[i]) {
+		case '0':
+			TEST_ASSERT_TRUE((c >= '0' && c <= '9') || (!rfc5424 && i == 4 && c == ' '));
+			break;
+
+		case 'M':
+			TEST_ASSERT_TRUE(c >= 'A' && c <= 'Z');
+			break;
+
+		case 'm':
+			TEST_ASSERT_TRUE(c >= 'a' && c <= 'z');
+			break;
+
+		default:
+			TEST_ASSERT_EQUAL_CHAR(format[i], c);
+			break;
+		}
+	}
+
+	return std::string{text}.erase(pos, length);
+}
+
+/*
+ * Messages must be sent as RFC 5424 syslog messages in UDP datagrams.
+ */
+void test_rfc5424_udp() {
+	uint16_t port;
+	int fd = listen_socket(SOCK_DGRAM, port);
+	SyslogHandler handler;
+
+	handler.hostname("host");
+	handler.app_name("app");
+	TEST_ASSERT_EQUAL_STRING("host", handler.hostname().c_str());
+	TEST_ASSERT_EQUAL_STRING("app", handler.app_name().c_str());
+	TEST_ASSERT_TRUE(handler.destination("127.0.0.1", port));
+
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "Connected");
+	handler << create_message(Level::TRACE, Facility::LOCAL7, "wifi ap", "Hello, World!");
+	handler << create_message(Level::EMERG, Facility::KERN, "", "");
+	handler.loop();
+
+	TEST_ASSERT_EQUAL_STRING("<134>1  host app - wifi - Connected",
+		remove_timestamp(receive(fd), 7, true).c_str());
+	TEST_ASSERT_EQUAL_STRING("<191>1  host app - wifi_ap - Hello, World!",
+		remove_timestamp(receive(fd), 7, true).c_str());
+	TEST_ASSERT_EQUAL_STRING("<0>1  host app - - - ",
+		remove_timestamp(receive(fd), 5, true).c_str());
+
+	handler.hostname("");
+	handler.app_name("");
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "Disconnected");
+	handler.loop();
+
+	TEST_ASSERT_EQUAL_STRING("<134>1  - - - wifi - Disconnected",
+		remove_timestamp(receive(fd), 7, true).c_str());
+	TEST_ASSERT_EQUAL_INT(0, handler.dropped_messages());
+
+	::close(fd);
+}
+
+/*
+ * Messages must be sent as RFC 3164 syslog messages in UDP datagrams.
+ */
+void test_rfc3164_udp() {
+	uint16_t port;
+	int fd = listen_socket(SOCK_DGRAM, port);
+	SyslogHandler handler{SyslogHandler::Format::RFC3164};
+
+	handler.hostname("host");
+	TEST_ASSERT_TRUE(handler.destination("127.0.0.1", port, SyslogHandler::Transport::UDP));
+
+	handler << create_message(Level::INFO, Facility::DAEMON, "wifi", "Connected");
+	handler << create_message(Level::ERR, Facility::LOCAL0, "wifi.ap", "Failed");
+	handler.loop();
+
+	TEST_ASSERT_EQUAL_STRING("<30> host wifi: Connected",
+		remove_timestamp(receive(fd), 4, false).c_str());
+	TEST_ASSERT_EQUAL_STRING("<131> host wifi_ap: Failed",
+		remove_timestamp(receive(fd), 5, false).c_str());
+
+	::close(fd);
+}
+
+/*
+ * Messages must be sent in batches over TCP using octet counting.
+ */
+void test_tcp() {
+	uint16_t port;
+	int listen_fd = listen_socket(SOCK_STREAM, port);
+	SyslogHandler handler;
+
+	handler.hostname("host");
+	TEST_ASSERT_TRUE(handler.destination("127.0.0.1", port, SyslogHandler::Transport::TCP));
+
+	int fd = ::accept(listen_fd, nullptr, nullptr);
+
+	TEST_ASSERT_TRUE(fd >= 0);
+
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "Connected");
+	handler << create_message(Level::NOTICE, Facility::LOCAL0, "mqtt", "Connected");
+	handler << create_message(Level::DEBUG, Facility::LOCAL0, "mqtt", std::string(200, 'x').c_str());
+	handler.loop();
+
+	std::string data;
+	std::vector<std::string> messages;
+
+	while (messages.size() < 3) {
+		std::string received = receive(fd);
+
+		TEST_ASSERT_FALSE(received.empty());
+		data.append(received);
+
+		size_t space;
+
+		while ((space = data.find(' ')) != std::string::npos) {
+			size_t length = std::strtoul(data.c_str(), nullptr, 10);
+
+			TEST_ASSERT_EQUAL_STRING(std::to_string(length).c_str(), data.substr(0, space).c_str());
+
+			if (data.length() < space + 1 + length) {
+				break;
+			}
+
+			messages.push_back(data.substr(space + 1, length));
+			data.erase(0, space + 1 + length);
+		}
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, data.length());
+	TEST_ASSERT_EQUAL_STRING("<134>1  host - - wifi - Connected",
+		remove_timestamp(messages[0], 7, true).c_str());
+	TEST_ASSERT_EQUAL_STRING("<133>1  host - - mqtt - Connected",
+		remove_timestamp(messages[1], 7, true).c_str());
+	TEST_ASSERT_EQUAL_STRING(("<135>1  host - - mqtt - " + std::string(200, 'x')).c_str(),
+		remove_timestamp(messages[2], 7, true).c_str());
+
+	/* Messages that can't be sent are discarded */
+	::close(fd);
+	::close(listen_fd);
+
+	for (unsigned int i = 0; i < 10; i++) {
+		handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "Disconnected");
+		handler.loop();
+	}
+
+	TEST_ASSERT_GREATER_THAN(0, handler.dropped_messages());
+}
+
+/*
+ * Messages must be discarded when the queue is full or there is no
+ * destination.
+ */
+void test_queue() {
+	uint16_t port;
+	int fd = listen_socket(SOCK_DGRAM, port);
+	SyslogHandler handler;
+
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "Ignored");
+
+	handler.maximum_log_messages(2);
+	TEST_ASSERT_EQUAL_INT(2, handler.maximum_log_messages());
+	TEST_ASSERT_TRUE(handler.destination("127.0.0.1", port));
+
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "1");
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "2");
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "3");
+	TEST_ASSERT_EQUAL_INT(1, handler.dropped_messages());
+	handler.loop();
+
+	TEST_ASSERT_EQUAL_STRING("<134>1  - - - wifi - 1", remove_timestamp(receive(fd), 7, true).c_str());
+	TEST_ASSERT_EQUAL_STRING("<134>1  - - - wifi - 2", remove_timestamp(receive(fd), 7, true).c_str());
+
+	handler.close();
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "Ignored");
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(1, handler.dropped_messages());
+
+	::close(fd);
+}
+
+/*
+ * UDP sockets that fail to connect must be retried after the reconnect
+ * interval.
+ */
+void test_udp_reconnect() {
+	uint16_t port;
+	int fd = listen_socket(SOCK_DGRAM, port);
+	SyslogHandler handler;
+	struct rlimit limit;
+	int next_fd = ::dup(0);
+
+	/* Prevent any more files from being opened so that the socket can't be created */
+	TEST_ASSERT_TRUE(next_fd >= 0);
+	::close(next_fd);
+	TEST_ASSERT_EQUAL_INT(0, ::getrlimit(RLIMIT_NOFILE, &limit));
+	struct rlimit restricted = limit;
+	restricted.rlim_cur = next_fd;
+	TEST_ASSERT_EQUAL_INT(0, ::setrlimit(RLIMIT_NOFILE, &restricted));
+
+	TEST_ASSERT_FALSE(handler.destination("127.0.0.1", port));
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "1");
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(1, handler.dropped_messages());
+
+	TEST_ASSERT_EQUAL_INT(0, ::setrlimit(RLIMIT_NOFILE, &limit));
+
+	now_ms += SyslogHandler::RECONNECT_INTERVAL_MS - 1;
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "2");
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(2, handler.dropped_messages());
+
+	now_ms += 1;
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "3");
+	handler.loop();
+	TEST_ASSERT_EQUAL_INT(2, handler.dropped_messages());
+	TEST_ASSERT_EQUAL_STRING("<134>1  - - - wifi - 3", remove_timestamp(receive(fd), 7, true).c_str());
+
+	::close(fd);
+}
+
+/*
+ * Create a TCP server that doesn't accept any more connections because
+ * its queue is full, so that connecting to it doesn't complete.
+ */
+static int full_socket(uint16_t &port, std::vector<int> &clients) {
+	int fd = listen_socket(SOCK_STREAM, port);
+	struct sockaddr_in address{};
+
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	TEST_ASSERT_EQUAL_INT(0, ::listen(fd, 0));
+
+	for (unsigned int i = 0; i < 2; i++) {
+		int client = ::socket(AF_INET, SOCK_STREAM, 0);
+
+		TEST_ASSERT_TRUE(client >= 0);
+		TEST_ASSERT_EQUAL_INT(0, ::fcntl(client, F_SETFL, O_NONBLOCK));
+		::connect(client, reinterpret_cast<struct sockaddr *>(&address), sizeof(address));
+		clients.push_back(client);
+	}
+
+	::usleep(100000);
+	return fd;
+}
+
+/*
+ * Connecting must be limited by the timeout and must not prevent
+ * messages from being logged.
+ */
+void test_connect_timeout() {
+	uint16_t port;
+	std::vector<int> clients;
+	int fd = full_socket(port, clients);
+	SyslogHandler handler;
+
+	auto start = std::chrono::steady_clock::now();
+	TEST_ASSERT_FALSE(handler.destination("127.0.0.1", port, SyslogHandler::Transport::TCP));
+	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	TEST_ASSERT_GREATER_OR_EQUAL(SyslogHandler::CONNECT_TIMEOUT_MS / 2, elapsed);
+	TEST_ASSERT_LESS_OR_EQUAL(SyslogHandler::CONNECT_TIMEOUT_MS * 3, elapsed);
+
+#if UUID_LOG_THREAD_SAFE
+	std::atomic<bool> done{false};
+
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "1");
+	now_ms += SyslogHandler::RECONNECT_INTERVAL_MS;
+
+	std::thread reconnect{[&handler, &done] {
+		handler.loop();
+		done = true;
+	}};
+
+	::usleep(100000);
+	TEST_ASSERT_FALSE_MESSAGE(done, "loop() must still be connecting");
+
+	start = std::chrono::steady_clock::now();
+	handler << create_message(Level::INFO, Facility::LOCAL0, "wifi", "2");
+	elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	TEST_ASSERT_FALSE_MESSAGE(done, "loop() must still be connecting");
+	TEST_ASSERT_LESS_OR_EQUAL(SyslogHandler::CONNECT_TIMEOUT_MS / 4, elapsed);
+
+	reconnect.join();
+	TEST_ASSERT_EQUAL_INT(1, handler.dropped_messages());
+#endif
+
+	for (int client : clients) {
+		::close(client);
+	}
+	::close(fd);
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_rfc5424_udp);
+	RUN_TEST(test_rfc3164_udp);
+	RUN_TEST(test_tcp);
+	RUN_TEST(test_queue);
+	RUN_TEST(test_udp_reconnect);
+	RUN_TEST(test_connect_timeout);
+
+	return UNITY_END();
+}
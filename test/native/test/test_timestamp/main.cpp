@@ -0,0 +1,169 @@
+/*
+ * uuid-log - Microcontroller logging framework
+ * Copyright 2024  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <uuid/log.h>
+
+using uuid::log::format_timestamp_ms;
+using uuid::log::MAX_TIMESTAMP_MS_LENGTH;
+using uuid::log::TimestampFormatter;
+
+namespace uuid {
+
+uint64_t get_uptime_ms() {
+	static uint64_t millis = 0;
+	return ++millis;
+}
+
+} // namespace uuid
+
+static std::string expected_timestamp(uint64_t timestamp_ms, unsigned int days_width) {
+	char text[64];
+
+	std::snprintf(text, sizeof(text), "%0*llu+%02u:%02u:%02u.%03u",
+		std::min(days_width, 12U), (unsigned long long)(timestamp_ms / 86400000ULL),
+		(unsigned int)(timestamp_ms / 3600000ULL % 24), (unsigned int)(timestamp_ms / 60000ULL % 60),
+		(unsigned int)(timestamp_ms / 1000ULL % 60), (unsigned int)(timestamp_ms % 1000));
+	return text;
+}
+
+static const std::vector<uint64_t> timestamps = {
+	0, 1, 999, 1000, 59999, 60000, 60001, 3599999, 3600000,
+	86399999, 86400000, 86400001, 863999999999ULL, 8640000000000ULL,
+	UINT32_MAX, (uint64_t)UINT32_MAX + 1, UINT64_MAX,
+};
+
+/*
+ * Formatting into a buffer must produce the same output as the string
+ * version for all days widths.
+ */
+void test_buffer() {
+	for (unsigned int days_width = 0; days_width <= 13; days_width++) {
+		for (auto timestamp_ms : timestamps) {
+			std::array<char,MAX_TIMESTAMP_MS_LENGTH + 1> text;
+			std::string expected = expected_timestamp(timestamp_ms, days_width);
+			size_t length = format_timestamp_ms(text.data(), text.size(), timestamp_ms, days_width);
+
+			TEST_ASSERT_EQUAL_STRING(expected.c_str(), text.data());
+			TEST_ASSERT_EQUAL_INT(expected.length(), length);
+			TEST_ASSERT_EQUAL_STRING(expected.c_str(), format_timestamp_ms(timestamp_ms, days_width).c_str());
+		}
+	}
+}
+
+/*
+ * Output must be truncated to fit in the buffer.
+ */
+void test_truncate() {
+	std::array<char,8> text;
+
+	text.fill('x');
+	TEST_ASSERT_EQUAL_INT(0, format_timestamp_ms(text.data(), 0, 1234, 3));
+	TEST_ASSERT_EQUAL_INT('x', text[0]);
+
+	TEST_ASSERT_EQUAL_INT(7, format_timestamp_ms(text.data(), text.size(), 1234, 3));
+	TEST_ASSERT_EQUAL_STRING("000+00:", text.data());
+}
+
+/*
+ * The incremental formatter must produce the same output as the buffer
+ * version when timestamps move forwards and backwards.
+ */
+void test_formatter() {
+	TimestampFormatter formatter{3};
+	std::vector<uint64_t> sequence = timestamps;
+
+	for (uint64_t timestamp_ms = 86340000; timestamp_ms < 86520000; timestamp_ms += 997) {
+		sequence.push_back(timestamp_ms);
+	}
+
+	sequence.insert(sequence.end(), timestamps.rbegin(), timestamps.rend());
+
+	for (auto timestamp_ms : sequence) {
+		std::array<char,MAX_TIMESTAMP_MS_LENGTH + 1> text;
+		std::string expected = expected_timestamp(timestamp_ms, 3);
+		size_t length = formatter.format(text.data(), text.size(), timestamp_ms);
+
+		TEST_ASSERT_EQUAL_STRING(expected.c_str(), text.data());
+		TEST_ASSERT_EQUAL_INT(expected.length(), length);
+	}
+}
+
+/*
+ * Compare the time taken to format the timestamps of a full queue of
+ * messages.
+ */
+void test_benchmark() {
+	static constexpr unsigned int ITERATIONS = 20000;
+	static constexpr unsigned int MESSAGES = 50;
+	TimestampFormatter formatter{3};
+	std::array<char,MAX_TIMESTAMP_MS_LENGTH + 1> text;
+	size_t total = 0;
+	char result[128];
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < ITERATIONS; i++) {
+		for (unsigned int j = 0; j < MESSAGES; j++) {
+			total += format_timestamp_ms(86400000ULL + i * MESSAGES + j, 3).length();
+		}
+	}
+	auto string_elapsed = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < ITERATIONS; i++) {
+		for (unsigned int j = 0; j < MESSAGES; j++) {
+			total += format_timestamp_ms(text.data(), text.size(), 86400000ULL + i * MESSAGES + j, 3);
+		}
+	}
+	auto buffer_elapsed = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < ITERATIONS; i++) {
+		for (unsigned int j = 0; j < MESSAGES; j++) {
+			total += formatter.format(text.data(), text.size(), 86400000ULL + i * MESSAGES + j);
+		}
+	}
+	auto formatter_elapsed = std::chrono::steady_clock::now() - start;
+
+	TEST_ASSERT_EQUAL_INT(3 * ITERATIONS * MESSAGES * 16, total);
+
+	std::snprintf(result, sizeof(result), "%u timestamps: string %lldus, buffer %lldus, incremental %lldus",
+		ITERATIONS * MESSAGES,
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(string_elapsed).count(),
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(buffer_elapsed).count(),
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(formatter_elapsed).count());
+	TEST_MESSAGE(result);
+}
+
+int main(int argc, char *argv[]) {
+	UNITY_BEGIN();
+	RUN_TEST(test_buffer);
+	RUN_TEST(test_truncate);
+	RUN_TEST(test_formatter);
+	RUN_TEST(test_benchmark);
+	return UNITY_END();
+}